@@ -12,7 +12,25 @@
 /* Imported libraries. */
 #include <fstream>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <deque>
+#include <set>
+#include <bitset>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <boost/algorithm/string.hpp>
 #include <opencv2/opencv.hpp>
@@ -23,12 +41,17 @@ using namespace cv;
 using namespace boost;
 
 /* Configuration operation values of the labeler. */
-/** Size of the buffers to hold in memory part of the frames of the video to be tagged. */
-int VIDEO_FRAME_BUFFERS_SIZE = 64; // times 3 buffers
+/** Size of the blocks of frames of the video to be tagged that are prefetched together;
+ *  the frame cache holds in memory up to PREFETCH_MAX_BLOCKS_AHEAD + 2 of them around the
+ *  frame being shown. */
+int VIDEO_FRAME_BUFFERS_SIZE = 64; // times up to 8 blocks
 
 /** Number of frames to jump when wanted (by the means of the w/z keys). */
 int FRAME_JUMP_SIZE = 100;
 
+/** Capacity of the queues between the stages of the frame extraction pipeline. */
+int FRAME_EXTRACTION_QUEUE_SIZE = 32;
+
 /** Returns the current date and time. */
 string getCurrentDateTime() {
     time_t now = time(0);
@@ -37,296 +60,3247 @@ string getCurrentDateTime() {
     tstruct = *localtime(&now);
     strftime(buf, sizeof(buf), "%Y-%m-%d.%X", &tstruct);
 
-    return buf;
+    return buf;
+}
+
+/** Reads a list with absolute paths to videos, from a given text file. */
+void readVideoFilePathList(string inputFilePath, vector <string> *answer) {
+    // input text file reader
+    ifstream fileReader;
+    fileReader.open(inputFilePath.data());
+    if (fileReader.fail()) {
+        cerr << "Could not open file " << inputFilePath << "." << endl;
+        throw -1;
+    }
+
+    // holds the current line read from the input file
+    string line;
+
+    // while there are paths to be read, adds them to the answer
+    while (getline(fileReader, line))
+        answer->push_back(line);
+
+    // closes the input file
+    fileReader.close();
+}
+
+/** Determines new width and height values for the frames extracted from a given video file,
+ *  of which original dimensions are given as parameters, assuming that the user decided for
+ *  a new number of pixels per frame, and that the original video aspect ratio must be
+ *  maintained. If the desired new number of pixels per frame is greater than the original
+ *  one, this function does nothing (i.e. it simply returns the original video width and
+ *  height. */
+void calculateNewWidthAndHeight(int originalWidth, int originalHeight,
+                                int desiredPixelCount, int *newWidth, int *newHeight) {
+    int originalPixelCount = originalWidth * originalHeight;
+
+    // calculates the new width and height
+    if (desiredPixelCount < originalPixelCount) {
+        double videoAspectRatio = originalWidth * pow(originalHeight, -1);
+
+        *newHeight = round(sqrt(desiredPixelCount / videoAspectRatio));
+        *newWidth = round(videoAspectRatio * *newHeight);
+    }
+        // does not change video resolution, if the desired pixel count is greater than
+        // the current one
+    else {
+        *newHeight = originalHeight;
+        *newWidth = originalWidth;
+    }
+}
+
+/** Stages of the labeler of which durations are measured. */
+const int STAGE_VIDEO_DECODE = 0;   // mode 0: decoding of a video frame
+const int STAGE_FRAME_RESIZE = 1;   // mode 0: resizing of a frame
+const int STAGE_FRAME_ENCODE = 2;   // mode 0: encoding and saving of a frame
+const int STAGE_QUEUE_WAIT = 3;     // mode 0: waiting on the pipeline queues
+const int STAGE_FRAME_READ = 4;     // mode 1: reading and decoding of a frame to be shown
+const int STAGE_FRAME_WAIT = 5;     // mode 1: waiting for a frame not loaded yet
+const int STAGE_LOCK_WAIT = 6;      // mode 1: waiting for the lock of the frame cache
+const int STAGE_FRAME_COMPOSE = 7;  // mode 1: composition of the frame and its overlay
+const int STAGE_FRAME_SHOW = 8;     // mode 1: imshow
+const int STAGE_KEY_WAIT = 9;       // mode 1: waitKey
+const int STAGE_SHOT_SIGNATURE = 10; // mode 0: signature of a frame, for shot detection
+const int STAGE_VIDEO_PROBE = 11;   // all modes: probing of a video not catalogued yet
+const int STAGE_COUNT = 12;
+
+/** Names of the measured stages, as they are reported. */
+const char *STAGE_NAMES[STAGE_COUNT] = {"video_decode", "frame_resize", "frame_encode",
+                                        "queue_wait", "frame_read", "frame_wait",
+                                        "lock_wait", "frame_compose", "frame_show",
+                                        "key_wait", "shot_signature", "video_probe"};
+
+/** Number of buckets of the latency histograms: durations (in microseconds) are bucketed
+ *  with four linear sub-buckets per power of two, for a relative error below 25%. */
+const int STAGE_HISTOGRAM_BUCKET_COUNT = 160;
+
+/** Duration counters and latency histogram of a measured stage. Updated with relaxed
+ *  atomic operations, so they can be left on at no noticeable cost. */
+struct StageTimer {
+    atomic <uint64_t> count, totalMicroseconds, maxMicroseconds;
+    atomic <uint64_t> histogram[STAGE_HISTOGRAM_BUCKET_COUNT];
+};
+
+/** Timers of the measured stages. */
+StageTimer STAGE_TIMERS[STAGE_COUNT];
+
+/** Returns the histogram bucket of the given duration <microseconds>. */
+int getStageHistogramBucket(uint64_t microseconds) {
+    if (microseconds < 4)
+        return int(microseconds);
+
+    int exponent = 63 - __builtin_clzll(microseconds);
+    int bucket = 4 * (exponent - 1) + int((microseconds >> (exponent - 2)) & 3);
+    return min(bucket, STAGE_HISTOGRAM_BUCKET_COUNT - 1);
+}
+
+/** Returns the lowest duration (in microseconds) of the given histogram bucket <bucket>. */
+uint64_t getStageHistogramBucketFloor(int bucket) {
+    if (bucket < 4)
+        return uint64_t(bucket);
+
+    int exponent = bucket / 4 + 1;
+    return uint64_t(4 + bucket % 4) << (exponent - 2);
+}
+
+/** Records that the stage <stage> ran from <beginTime> until now. */
+void recordStageTime(int stage, chrono::steady_clock::time_point beginTime) {
+    uint64_t microseconds = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - beginTime).count();
+
+    StageTimer *stageTimer = &STAGE_TIMERS[stage];
+    stageTimer->count.fetch_add(1, memory_order_relaxed);
+    stageTimer->totalMicroseconds.fetch_add(microseconds, memory_order_relaxed);
+    stageTimer->histogram[getStageHistogramBucket(microseconds)].fetch_add(
+            1, memory_order_relaxed);
+
+    uint64_t maxMicroseconds = stageTimer->maxMicroseconds.load(memory_order_relaxed);
+    while (microseconds > maxMicroseconds
+           && !stageTimer->maxMicroseconds.compare_exchange_weak(maxMicroseconds,
+                                                                  microseconds,
+                                                                  memory_order_relaxed));
+}
+
+/** Returns the duration (in microseconds) below which the given fraction <quantile> of the
+ *  runs of the stage <stage> fall, approximated by the floor of its histogram bucket. */
+uint64_t getStageTimeQuantile(int stage, double quantile) {
+    StageTimer *stageTimer = &STAGE_TIMERS[stage];
+    uint64_t count = stageTimer->count.load(memory_order_relaxed);
+    if (count == 0)
+        return 0;
+
+    uint64_t wantedCount = uint64_t(ceil(quantile * count));
+    uint64_t cumulativeCount = 0;
+    for (int i = 0; i < STAGE_HISTOGRAM_BUCKET_COUNT; i++) {
+        cumulativeCount += stageTimer->histogram[i].load(memory_order_relaxed);
+        if (cumulativeCount >= wantedCount)
+            return getStageHistogramBucketFloor(i);
+    }
+    return stageTimer->maxMicroseconds.load(memory_order_relaxed);
+}
+
+/** Saves the counters and histograms of the measured stages (the ones that ran at least
+ *  once) as a JSON file, at the given path <filePath>. */
+void saveStageTimes(string filePath) {
+    ofstream fileWriter(filePath.data());
+    if (fileWriter.fail()) {
+        cerr << "Could not save stage times at " << filePath << "." << endl;
+        return;
+    }
+
+    fileWriter << "{" << endl;
+    bool firstStage = true;
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        StageTimer *stageTimer = &STAGE_TIMERS[stage];
+        uint64_t count = stageTimer->count.load(memory_order_relaxed);
+        if (count == 0)
+            continue;
+
+        uint64_t totalMicroseconds = stageTimer->totalMicroseconds.load(memory_order_relaxed);
+        fileWriter << (firstStage ? "" : ",\n") << "  \"" << STAGE_NAMES[stage] << "\": {"
+                   << "\"count\": " << count
+                   << ", \"total_us\": " << totalMicroseconds
+                   << ", \"mean_us\": " << totalMicroseconds / count
+                   << ", \"p50_us\": " << getStageTimeQuantile(stage, 0.50)
+                   << ", \"p90_us\": " << getStageTimeQuantile(stage, 0.90)
+                   << ", \"p99_us\": " << getStageTimeQuantile(stage, 0.99)
+                   << ", \"max_us\": " << stageTimer->maxMicroseconds.load(memory_order_relaxed)
+                   << ", \"histogram\": [";
+
+        // non-empty buckets, as [floor_us, count] pairs
+        bool firstBucket = true;
+        for (int i = 0; i < STAGE_HISTOGRAM_BUCKET_COUNT; i++) {
+            uint64_t bucketCount = stageTimer->histogram[i].load(memory_order_relaxed);
+            if (bucketCount == 0)
+                continue;
+
+            fileWriter << (firstBucket ? "" : ", ") << "[" << getStageHistogramBucketFloor(i)
+                       << ", " << bucketCount << "]";
+            firstBucket = false;
+        }
+
+        fileWriter << "]}";
+        firstStage = false;
+    }
+    fileWriter << endl << "}" << endl;
+
+    fileWriter.close();
+}
+
+/** Bounded queue of numbered video frames, connecting two stages of the frame
+ *  extraction pipeline. Producers block while the queue is full (backpressure),
+ *  and consumers block while it is empty and some producer is still open. */
+struct VideoFrameQueue {
+    deque <pair<int, Mat>> frames;
+    int capacity;
+    int openProducerCount;
+    mutex queueMutex;
+    condition_variable notFullCondition, notEmptyCondition;
+};
+
+/** Prepares the given frame queue <frameQueue> to hold up to <capacity> frames,
+ *  fed by <producerCount> producers. */
+void openVideoFrameQueue(VideoFrameQueue *frameQueue, int capacity, int producerCount) {
+    frameQueue->frames.clear();
+    frameQueue->capacity = capacity;
+    frameQueue->openProducerCount = producerCount;
+}
+
+/** Adds the given frame <frame>, of number <frameNumber>, to the given queue
+ *  <frameQueue>, waiting while the queue is full. */
+void pushVideoFrame(VideoFrameQueue *frameQueue, int frameNumber, Mat frame) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    unique_lock <mutex> queueLock(frameQueue->queueMutex);
+    frameQueue->notFullCondition.wait(queueLock, [frameQueue] {
+        return frameQueue->frames.size() < frameQueue->capacity;
+    });
+    recordStageTime(STAGE_QUEUE_WAIT, beginTime);
+
+    frameQueue->frames.push_back(make_pair(frameNumber, frame));
+    frameQueue->notEmptyCondition.notify_one();
+}
+
+/** Removes the oldest frame from the given queue <frameQueue>, waiting while the
+ *  queue is empty. Returns FALSE if the queue was closed and has no more frames,
+ *  TRUE otherwise (with the frame in <frame> and its number in <frameNumber>). */
+bool popVideoFrame(VideoFrameQueue *frameQueue, int *frameNumber, Mat *frame) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    unique_lock <mutex> queueLock(frameQueue->queueMutex);
+    frameQueue->notEmptyCondition.wait(queueLock, [frameQueue] {
+        return !frameQueue->frames.empty() || frameQueue->openProducerCount <= 0;
+    });
+    recordStageTime(STAGE_QUEUE_WAIT, beginTime);
+
+    if (frameQueue->frames.empty())
+        return false;
+
+    *frameNumber = frameQueue->frames.front().first;
+    *frame = frameQueue->frames.front().second;
+    frameQueue->frames.pop_front();
+    frameQueue->notFullCondition.notify_one();
+    return true;
+}
+
+/** Tells the given queue <frameQueue> that one of its producers is done. Once all of
+ *  them are done, the queue is closed, and its consumers learn that no more frames
+ *  will be added. */
+void closeVideoFrameQueue(VideoFrameQueue *frameQueue) {
+    lock_guard <mutex> queueLock(frameQueue->queueMutex);
+    frameQueue->openProducerCount--;
+    frameQueue->notEmptyCondition.notify_all();
+}
+
+/** Returns the file path of the frame of number <frameNumber>, extracted from the
+ *  video of file name <videoFileName> into the directory <frameDirPath>. */
+string getFrameFilePath(string frameDirPath, string videoFileName, int frameNumber) {
+    // completes the number of the frame with zeros
+    char frameNumberChars[16];
+    sprintf(frameNumberChars, "%.7d", frameNumber);
+
+    // mounts the name of the current file
+    stringstream frameFilePathStream;
+    frameFilePathStream << frameDirPath << "/" << videoFileName << "-"
+                        << frameNumberChars << ".jpg";
+    return frameFilePathStream.str();
+}
+
+/** Returns the number of the frame of the given file path <frameFilePath> (as named by
+ *  getFrameFilePath()), or -1 if the file is not named after a frame number. */
+int getFrameFileNumber(string frameFilePath) {
+    size_t numberPosition = frameFilePath.rfind('-');
+    size_t extensionPosition = frameFilePath.rfind(".jpg");
+    if (numberPosition == string::npos || extensionPosition == string::npos
+        || extensionPosition <= numberPosition + 1)
+        return -1;
+
+    string frameNumberChars = frameFilePath.substr(numberPosition + 1,
+                                                   extensionPosition - numberPosition - 1);
+    if (frameNumberChars.find_first_not_of("0123456789") != string::npos)
+        return -1;
+    return stoi(frameNumberChars);
+}
+
+/** Identifier of the packed frame archives, at the beginning of their header. */
+const char FRAME_ARCHIVE_MAGIC[8] = {'F', 'L', 'B', 'L', 'A', 'R', 'C', '1'};
+
+/** Header of a packed frame archive. The archive holds all the frames extracted from a
+ *  video in a single file, laid out as this header, the JPG-encoded frames concatenated,
+ *  and an index with the position of each frame (written last, so the archive is
+ *  produced in a single streaming pass). */
+struct FrameArchiveHeader {
+    char magic[8];
+    uint64_t frameCount;
+    uint64_t indexOffset;
+    char videoFileName[256];
+};
+
+/** Entry of the index of a packed frame archive, one per frame, in frame number order. */
+struct FrameArchiveIndexEntry {
+    uint64_t offset;
+    uint64_t size;
+};
+
+/** Writer of a packed frame archive, shared by the encoders of a video. */
+struct FrameArchiveWriter {
+    string archiveFilePath;
+    FILE *archiveFile;
+    uint64_t currentOffset;
+    vector <FrameArchiveIndexEntry> index;
+    mutex archiveMutex;
+};
+
+/** Returns the file path of the packed frame archive of the video of file name
+ *  <videoFileName>, to be saved into the directory <frameDirPath>. */
+string getFrameArchiveFilePath(string frameDirPath, string videoFileName) {
+    return frameDirPath + "/" + videoFileName + ".fla";
+}
+
+/** Removes, from the directory <frameDirPath>, all the frames extracted from the video of
+ *  file name <videoFileName>: its frame files (whatever their numbers) and its packed
+ *  frame archive. */
+void removeExtractedFrames(string frameDirPath, string videoFileName) {
+    remove(getFrameArchiveFilePath(frameDirPath, videoFileName).data());
+
+    DIR *frameDir = opendir(frameDirPath.data());
+    if (frameDir == NULL)
+        return;
+
+    string frameFilePrefix = videoFileName + "-";
+    struct dirent *dirEntry;
+    while ((dirEntry = readdir(frameDir)) != NULL) {
+        string fileName = dirEntry->d_name;
+        if (fileName.compare(0, frameFilePrefix.length(), frameFilePrefix) == 0
+            && fileName.rfind('-') == frameFilePrefix.length() - 1
+            && getFrameFileNumber(fileName) >= 0)
+            remove((frameDirPath + "/" + fileName).data());
+    }
+    closedir(frameDir);
+}
+
+/** Creates the packed frame archive <archiveFilePath> and prepares <archiveWriter> to
+ *  fill it. */
+void openFrameArchiveWriter(string archiveFilePath, FrameArchiveWriter *archiveWriter) {
+    archiveWriter->archiveFilePath = archiveFilePath;
+    archiveWriter->archiveFile = fopen(archiveFilePath.data(), "wb");
+    if (archiveWriter->archiveFile == NULL) {
+        cerr << "Could not write file " << archiveFilePath << "." << endl;
+        throw -1;
+    }
+
+    // the header is rewritten with the final values when the archive is closed
+    FrameArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, archiveWriter->archiveFile);
+
+    archiveWriter->currentOffset = sizeof(header);
+    archiveWriter->index.clear();
+}
+
+/** Appends the given JPG-encoded frame <encodedFrame>, of number <frameNumber>, to the
+ *  archive of <archiveWriter>. The frames may be appended in any order. */
+void appendFrameToArchive(FrameArchiveWriter *archiveWriter, int frameNumber,
+                          vector <uchar> *encodedFrame) {
+    lock_guard <mutex> archiveLock(archiveWriter->archiveMutex);
+
+    fwrite(encodedFrame->data(), 1, encodedFrame->size(), archiveWriter->archiveFile);
+
+    if (archiveWriter->index.size() <= frameNumber)
+        archiveWriter->index.resize(frameNumber + 1, FrameArchiveIndexEntry{0, 0});
+    archiveWriter->index.at(frameNumber).offset = archiveWriter->currentOffset;
+    archiveWriter->index.at(frameNumber).size = encodedFrame->size();
+
+    archiveWriter->currentOffset += encodedFrame->size();
+}
+
+/** Finishes the archive of <archiveWriter>, writing its index and header. */
+void closeFrameArchiveWriter(FrameArchiveWriter *archiveWriter, string videoFileName) {
+    // aligns the index, so it can be read in place once the archive is mapped
+    while (archiveWriter->currentOffset % sizeof(uint64_t) != 0) {
+        fputc(0, archiveWriter->archiveFile);
+        archiveWriter->currentOffset++;
+    }
+
+    FrameArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_ARCHIVE_MAGIC, sizeof(header.magic));
+    header.frameCount = archiveWriter->index.size();
+    header.indexOffset = archiveWriter->currentOffset;
+    strncpy(header.videoFileName, videoFileName.data(), sizeof(header.videoFileName) - 1);
+
+    fwrite(archiveWriter->index.data(), sizeof(FrameArchiveIndexEntry),
+           archiveWriter->index.size(), archiveWriter->archiveFile);
+    fseek(archiveWriter->archiveFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, archiveWriter->archiveFile);
+
+    if (fclose(archiveWriter->archiveFile) != 0) {
+        cerr << "Could not write file " << archiveWriter->archiveFilePath << "." << endl;
+        throw -2;
+    }
+    archiveWriter->archiveFile = NULL;
+}
+
+/** Resizing stage of the frame extraction pipeline. Takes the frames from
+ *  <inputFrameQueue>, resizes them to the given new desired total number of pixels
+ *  per frame <totalPixelCount> (maintaining the aspect ratio), and hands them over to
+ *  <outputFrameQueue>. The new dimensions are calculated from the first frame. */
+void resizeVideoFrames(VideoFrameQueue *inputFrameQueue, VideoFrameQueue *outputFrameQueue,
+                       int totalPixelCount) {
+    int frameWidth = 0, frameHeight = 0;
+
+    int frameNumber;
+    Mat currentFrame;
+    while (popVideoFrame(inputFrameQueue, &frameNumber, &currentFrame)) {
+        // determines new frame width and frame height values, if it is the case
+        if (frameWidth == 0 && frameHeight == 0)
+            calculateNewWidthAndHeight(currentFrame.cols, currentFrame.rows,
+                                       totalPixelCount, &frameWidth, &frameHeight);
+
+        // if the frame is to be resized, does it
+        if (frameWidth != currentFrame.cols || frameHeight != currentFrame.rows) {
+            chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+            Mat resizedFrame;
+            resize(currentFrame, resizedFrame, Size(frameWidth, frameHeight),
+                   INTER_CUBIC);
+            currentFrame = resizedFrame;
+            recordStageTime(STAGE_FRAME_RESIZE, beginTime);
+        }
+
+        pushVideoFrame(outputFrameQueue, frameNumber, currentFrame);
+    }
+
+    closeVideoFrameQueue(outputFrameQueue);
+}
+
+/** Encoding stage of the frame extraction pipeline. Takes the frames from
+ *  <inputFrameQueue> and saves them as JPG images in the directory <frameDirPath>,
+ *  named after the video file name <videoFileName>. Many of these workers can
+ *  consume the same queue, since each frame carries its own number. */
+void encodeAndSaveVideoFrames(VideoFrameQueue *inputFrameQueue, string frameDirPath,
+                              string videoFileName) {
+    int frameNumber;
+    Mat currentFrame;
+    while (popVideoFrame(inputFrameQueue, &frameNumber, &currentFrame)) {
+        chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+        imwrite(getFrameFilePath(frameDirPath, videoFileName, frameNumber),
+                currentFrame);
+        recordStageTime(STAGE_FRAME_ENCODE, beginTime);
+    }
+}
+
+/** Encoding stage of the frame extraction pipeline, when the frames are packed into an
+ *  archive. Takes the frames from <inputFrameQueue>, encodes them as JPG images and
+ *  appends them to the archive of <archiveWriter>. */
+void encodeAndArchiveVideoFrames(VideoFrameQueue *inputFrameQueue,
+                                 FrameArchiveWriter *archiveWriter) {
+    int frameNumber;
+    Mat currentFrame;
+    vector <uchar> encodedFrame;
+    while (popVideoFrame(inputFrameQueue, &frameNumber, &currentFrame)) {
+        chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+        imencode(".jpg", currentFrame, encodedFrame);
+        appendFrameToArchive(archiveWriter, frameNumber, &encodedFrame);
+        recordStageTime(STAGE_FRAME_ENCODE, beginTime);
+    }
+}
+
+/** Identifier of the video index files, at the beginning of their header. */
+const char VIDEO_INDEX_MAGIC[8] = {'F', 'L', 'B', 'L', 'I', 'D', 'X', '2'};
+
+/** Seek index of a video: its number of frames, frame rate, key frame numbers and
+ *  per-frame presentation timestamps (in milliseconds), with the frames numbered in
+ *  the order they are decoded (as done by extractAndSaveVideoFrames()). */
+struct VideoIndex {
+    int frameCount;
+    double videoFPS;
+    vector<int> keyFrameNumbers;
+    vector<double> frameTimestamps;
+};
+
+/** Header of a video index file, followed by the key frame numbers (32-bit integers),
+ *  by the frame timestamps (doubles) and by the absolute path of the indexed video. The
+ *  size and modification time of the indexed video tell if the index is still up to
+ *  date; its path tells, to the frames extracted alongside the index, their video. */
+struct VideoIndexFileHeader {
+    char magic[8];
+    int64_t videoFileSize;
+    int64_t videoModificationTime;
+    int32_t frameCount;
+    int32_t keyFrameCount;
+    double videoFPS;
+    int32_t videoFilePathLength;
+};
+
+/** Returns the file path of the index of the video of file name <videoFileName>,
+ *  to be saved into the directory <dirPath>. */
+string getVideoIndexFilePath(string dirPath, string videoFileName) {
+    return dirPath + "/" + videoFileName + ".fidx";
+}
+
+/** Builds the index <videoIndex> of the video stored in <videoFilePath>, by scanning
+ *  its packets without decoding them. */
+void buildVideoIndex(string videoFilePath, VideoIndex *videoIndex) {
+    // raw stream reader: grab() only demuxes the next packet
+    VideoCapture videoReader(videoFilePath, CAP_FFMPEG);
+    videoReader.set(CAP_PROP_FORMAT, -1);
+
+    videoIndex->frameCount = 0;
+    videoIndex->videoFPS = videoReader.get(CAP_PROP_FPS);
+    videoIndex->keyFrameNumbers.clear();
+    videoIndex->frameTimestamps.clear();
+
+    while (videoReader.grab()) {
+        if (videoReader.get(CAP_PROP_LRF_HAS_KEY_FRAME) != 0)
+            videoIndex->keyFrameNumbers.push_back(videoIndex->frameCount);
+        videoIndex->frameTimestamps.push_back(videoReader.get(CAP_PROP_POS_MSEC));
+        videoIndex->frameCount++;
+    }
+
+    // packets come in decoding order; frames are presented in timestamp order
+    sort(videoIndex->frameTimestamps.begin(), videoIndex->frameTimestamps.end());
+
+    videoReader.release();
+}
+
+/** Saves the given index <videoIndex> of the video stored in <videoFilePath> into the
+ *  file <indexFilePath>. Returns FALSE if the index file could not be written. */
+bool saveVideoIndex(string videoFilePath, string indexFilePath, VideoIndex *videoIndex) {
+    struct stat videoStat;
+    if (stat(videoFilePath.data(), &videoStat) != 0)
+        return false;
+
+    VideoIndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VIDEO_INDEX_MAGIC, sizeof(header.magic));
+    header.videoFileSize = videoStat.st_size;
+    header.videoModificationTime = videoStat.st_mtime;
+    header.frameCount = videoIndex->frameCount;
+    header.keyFrameCount = videoIndex->keyFrameNumbers.size();
+    header.videoFPS = videoIndex->videoFPS;
+
+    // absolute path of the video, so it is found from wherever its frames are annotated
+    char *absoluteVideoFilePath = realpath(videoFilePath.data(), NULL);
+    string indexedVideoFilePath = (absoluteVideoFilePath != NULL ?
+                                   string(absoluteVideoFilePath) : videoFilePath);
+    free(absoluteVideoFilePath);
+    header.videoFilePathLength = indexedVideoFilePath.length();
+
+    vector <int32_t> keyFrameNumbers(videoIndex->keyFrameNumbers.begin(),
+                                     videoIndex->keyFrameNumbers.end());
+
+    ofstream indexWriter(indexFilePath.data(), ios::binary);
+    indexWriter.write((const char *) &header, sizeof(header));
+    indexWriter.write((const char *) keyFrameNumbers.data(),
+                      keyFrameNumbers.size() * sizeof(int32_t));
+    indexWriter.write((const char *) videoIndex->frameTimestamps.data(),
+                      videoIndex->frameTimestamps.size() * sizeof(double));
+    indexWriter.write(indexedVideoFilePath.data(), indexedVideoFilePath.length());
+    indexWriter.close();
+
+    return !indexWriter.fail();
+}
+
+/** Loads the index of the video stored in <videoFilePath> from the file
+ *  <indexFilePath> into <videoIndex>. If there is no such file, or if it is out of
+ *  date, the index is built and saved into it. */
+void loadVideoIndex(string videoFilePath, string indexFilePath, VideoIndex *videoIndex) {
+    struct stat videoStat;
+    if (stat(videoFilePath.data(), &videoStat) != 0) {
+        cerr << "Could not open file " << videoFilePath << "." << endl;
+        throw -1;
+    }
+
+    // tries to read the existing index file
+    ifstream indexReader(indexFilePath.data(), ios::binary);
+    if (!indexReader.fail()) {
+        VideoIndexFileHeader header;
+        indexReader.read((char *) &header, sizeof(header));
+
+        if (!indexReader.fail()
+            && memcmp(header.magic, VIDEO_INDEX_MAGIC, sizeof(header.magic)) == 0
+            && header.videoFileSize == videoStat.st_size
+            && header.videoModificationTime == videoStat.st_mtime) {
+            vector <int32_t> keyFrameNumbers(header.keyFrameCount);
+            videoIndex->frameTimestamps.resize(header.frameCount);
+            indexReader.read((char *) keyFrameNumbers.data(),
+                             keyFrameNumbers.size() * sizeof(int32_t));
+            indexReader.read((char *) videoIndex->frameTimestamps.data(),
+                             videoIndex->frameTimestamps.size() * sizeof(double));
+
+            if (!indexReader.fail()) {
+                videoIndex->frameCount = header.frameCount;
+                videoIndex->videoFPS = header.videoFPS;
+                videoIndex->keyFrameNumbers.assign(keyFrameNumbers.begin(),
+                                                   keyFrameNumbers.end());
+                return;
+            }
+        }
+    }
+    indexReader.close();
+
+    // builds a new index
+    buildVideoIndex(videoFilePath, videoIndex);
+    if (!saveVideoIndex(videoFilePath, indexFilePath, videoIndex))
+        cerr << "WARNING: Could not save video index " << indexFilePath << "." << endl;
+}
+
+/** Reads, from the video index file <indexFilePath>, the path of the indexed video into
+ *  <videoFilePath>. Returns FALSE if there is no such file, or if it is not valid. */
+bool loadIndexedVideoFilePath(string indexFilePath, string *videoFilePath) {
+    ifstream indexReader(indexFilePath.data(), ios::binary);
+    VideoIndexFileHeader header;
+    indexReader.read((char *) &header, sizeof(header));
+    if (indexReader.fail()
+        || memcmp(header.magic, VIDEO_INDEX_MAGIC, sizeof(header.magic)) != 0
+        || header.videoFilePathLength <= 0)
+        return false;
+
+    // skips the key frame numbers and the frame timestamps
+    indexReader.seekg(sizeof(header) + header.keyFrameCount * sizeof(int32_t)
+                      + header.frameCount * sizeof(double));
+
+    videoFilePath->resize(header.videoFilePathLength);
+    indexReader.read(&videoFilePath->at(0), header.videoFilePathLength);
+    return !indexReader.fail();
+}
+
+/** Returns TRUE if the frame last decoded by the given <videoReader> is the frame of
+ *  number <frameNumber>, i.e., if its timestamp is the one of that frame in the index
+ *  <videoIndex> (within half a frame period). Readers often report back the frame
+ *  position they were set to, so the timestamp is what tells where a seek landed. */
+bool isFrameDecoded(VideoCapture *videoReader, VideoIndex *videoIndex, int frameNumber) {
+    if (frameNumber < 0 || frameNumber >= videoIndex->frameTimestamps.size())
+        return false;
+
+    double tolerance = 500.0 / (videoIndex->videoFPS > 0 ? videoIndex->videoFPS : 25.0);
+    return std::abs(videoReader->get(CAP_PROP_POS_MSEC)
+                    - videoIndex->frameTimestamps.at(frameNumber)) <= tolerance;
+}
+
+/** Metadata of a video, as probed from its file: frame rate, number of frames,
+ *  resolution, codec (FourCC) and duration (in seconds). */
+struct VideoMetadata {
+    double frameRate;
+    int frameCount;
+    int width, height;
+    string codec;
+    double duration;
+};
+
+/** Catalog of the metadata of the videos, kept in a text file shared by all the modes,
+ *  so that each video is probed only once. Each line holds the metadata of a video
+ *  (frame rate, number of frames, width, height, codec and duration) and its key (size,
+ *  modification time and path of the video file), so that changed videos are probed
+ *  again. New entries are appended to the file as the videos are probed. All the
+ *  fields are protected by <catalogMutex>. */
+struct VideoCatalog {
+    unordered_map<string, VideoMetadata> videoMetadata;
+
+    // keys of the catalogued videos, by video file name and path (the last one of each
+    // path, since a changed video is catalogued again)
+    unordered_map<string, map<string, string>> videoFileKeys;
+
+    ofstream catalogWriter;
+    mutex catalogMutex;
+};
+
+/** Catalog of the videos, shared by all the modes. */
+VideoCatalog VIDEO_CATALOG;
+
+/** Returns the default path of the file of the video catalog (in the home directory of
+ *  the user, if known). */
+string getDefaultVideoCatalogFilePath() {
+    const char *homeDirPath = getenv("HOME");
+    return (homeDirPath != NULL ? string(homeDirPath) + "/" : string())
+           + ".framelabeler_catalog.txt";
+}
+
+/** Returns the key of the video stored in <videoFilePath> in the video catalog, or an
+ *  empty string if the file cannot be found. */
+string getVideoCatalogKey(string videoFilePath) {
+    struct stat videoStat;
+    if (stat(videoFilePath.data(), &videoStat) != 0)
+        return "";
+
+    return to_string(videoStat.st_size) + " " + to_string(videoStat.st_mtime) + " "
+           + videoFilePath;
+}
+
+/** Returns the file name of the video stored in <videoFilePath>. */
+string getVideoFileName(string videoFilePath) {
+    vector <string> tokens;
+    split(tokens, videoFilePath, is_any_of("/"));
+    return tokens.back();
+}
+
+/** Opens the video catalog <videoCatalog> kept in the file <catalogFilePath>, reading
+ *  the videos catalogued by previous runs, if any. */
+void openVideoCatalog(string catalogFilePath, VideoCatalog *videoCatalog) {
+    ifstream catalogReader(catalogFilePath.data());
+    string catalogLine;
+    while (getline(catalogReader, catalogLine)) {
+        stringstream catalogLineStream;
+        catalogLineStream << catalogLine;
+
+        VideoMetadata videoMetadata;
+        string catalogKey, videoFileSize, videoModificationTime, videoFilePath;
+        catalogLineStream >> videoMetadata.frameRate >> videoMetadata.frameCount
+                          >> videoMetadata.width >> videoMetadata.height
+                          >> videoMetadata.codec >> videoMetadata.duration
+                          >> videoFileSize >> videoModificationTime >> ws;
+        getline(catalogLineStream, videoFilePath);
+        if (catalogLineStream.fail() || videoFilePath.length() <= 0)
+            continue;
+
+        catalogKey = videoFileSize + " " + videoModificationTime + " " + videoFilePath;
+        videoCatalog->videoMetadata[catalogKey] = videoMetadata;
+        videoCatalog->videoFileKeys[getVideoFileName(videoFilePath)][videoFilePath] = catalogKey;
+    }
+    catalogReader.close();
+
+    videoCatalog->catalogWriter.open(catalogFilePath.data(), ios::app);
+    if (videoCatalog->catalogWriter.fail())
+        cerr << "WARNING: Could not write video catalog " << catalogFilePath << "." << endl;
+    videoCatalog->catalogWriter.precision(17);
+}
+
+/** Closes the given video catalog <videoCatalog>. */
+void closeVideoCatalog(VideoCatalog *videoCatalog) {
+    videoCatalog->catalogWriter.close();
+}
+
+/** Probes the video stored in <videoFilePath> into <videoMetadata>, opening it only
+ *  once. The container metadata is used, unless it lacks the number of frames, which
+ *  is then obtained by counting the packets of the video. Returns FALSE if the video
+ *  cannot be probed. */
+bool probeVideoMetadata(string videoFilePath, VideoMetadata *videoMetadata) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    VideoCapture videoReader(videoFilePath);
+    if (!videoReader.isOpened())
+        return false;
+
+    videoMetadata->frameRate = videoReader.get(CAP_PROP_FPS);
+    videoMetadata->frameCount = int(videoReader.get(CAP_PROP_FRAME_COUNT));
+    videoMetadata->width = int(videoReader.get(CAP_PROP_FRAME_WIDTH));
+    videoMetadata->height = int(videoReader.get(CAP_PROP_FRAME_HEIGHT));
+
+    // FourCC of the codec, or "-" if it is unknown
+    int fourcc = int(videoReader.get(CAP_PROP_FOURCC));
+    videoMetadata->codec = "";
+    for (int i = 0; i < 4; i++) {
+        char codecChar = char((fourcc >> (8 * i)) & 0xFF);
+        if (isgraph(codecChar))
+            videoMetadata->codec += codecChar;
+    }
+    if (videoMetadata->codec.length() <= 0)
+        videoMetadata->codec = "-";
+
+    if (videoMetadata->frameCount <= 0) {
+        videoReader.set(CAP_PROP_FORMAT, -1);
+        videoMetadata->frameCount = 0;
+        while (videoReader.grab())
+            videoMetadata->frameCount++;
+    }
+    videoReader.release();
+    recordStageTime(STAGE_VIDEO_PROBE, beginTime);
+
+    if (videoMetadata->frameRate <= 0 || videoMetadata->frameCount <= 0)
+        return false;
+
+    videoMetadata->duration = videoMetadata->frameCount / videoMetadata->frameRate;
+    return true;
+}
+
+/** Returns TRUE if the video stored in <videoFilePath> is in the given catalog
+ *  <videoCatalog>, putting its metadata in <videoMetadata>, FALSE otherwise. */
+bool findVideoMetadata(VideoCatalog *videoCatalog, string videoFilePath,
+                       VideoMetadata *videoMetadata) {
+    string catalogKey = getVideoCatalogKey(videoFilePath);
+
+    lock_guard <mutex> catalogLock(videoCatalog->catalogMutex);
+    auto catalogEntry = videoCatalog->videoMetadata.find(catalogKey);
+    if (catalogEntry == videoCatalog->videoMetadata.end())
+        return false;
+
+    *videoMetadata = catalogEntry->second;
+    return true;
+}
+
+/** Returns TRUE if a video of file name <videoFileName> is in the given catalog
+ *  <videoCatalog> (whatever its directory), putting its metadata in <videoMetadata>,
+ *  FALSE otherwise. Used when only the frames of the video are at hand, and their video
+ *  cannot be found by its path. If several catalogued videos have that name, but not
+ *  the same frame rate, there is no guessing which one it is, and FALSE is returned. */
+bool findVideoMetadataByName(VideoCatalog *videoCatalog, string videoFileName,
+                             VideoMetadata *videoMetadata) {
+    lock_guard <mutex> catalogLock(videoCatalog->catalogMutex);
+    auto videoFileKeys = videoCatalog->videoFileKeys.find(videoFileName);
+    if (videoFileKeys == videoCatalog->videoFileKeys.end())
+        return false;
+
+    *videoMetadata = videoCatalog->videoMetadata.at(videoFileKeys->second.begin()->second);
+    for (auto &videoFileKey : videoFileKeys->second)
+        if (videoCatalog->videoMetadata.at(videoFileKey.second).frameRate
+            != videoMetadata->frameRate) {
+            cerr << "WARNING: Catalogued videos named " << videoFileName
+                 << " have different frame rates." << endl;
+            return false;
+        }
+    return true;
+}
+
+/** Obtains the metadata <videoMetadata> of the video stored in <videoFilePath> from the
+ *  given catalog <videoCatalog>, probing the video (and cataloguing it) if it is not
+ *  there yet. Returns FALSE if the video cannot be probed. */
+bool getVideoMetadata(VideoCatalog *videoCatalog, string videoFilePath,
+                      VideoMetadata *videoMetadata) {
+    if (findVideoMetadata(videoCatalog, videoFilePath, videoMetadata))
+        return true;
+
+    // the video is probed without holding the lock
+    string catalogKey = getVideoCatalogKey(videoFilePath);
+    if (catalogKey.length() <= 0 || !probeVideoMetadata(videoFilePath, videoMetadata))
+        return false;
+
+    lock_guard <mutex> catalogLock(videoCatalog->catalogMutex);
+    videoCatalog->videoMetadata[catalogKey] = *videoMetadata;
+    videoCatalog->videoFileKeys[getVideoFileName(videoFilePath)][videoFilePath] = catalogKey;
+    videoCatalog->catalogWriter << videoMetadata->frameRate << " " << videoMetadata->frameCount
+                                << " " << videoMetadata->width << " " << videoMetadata->height
+                                << " " << videoMetadata->codec << " "
+                                << videoMetadata->duration << " " << catalogKey << endl;
+    return true;
+}
+
+/** Size of the frame signatures compared to detect shot boundaries: each frame is
+ *  reduced to this thumbnail, first sampled to SHOT_SIGNATURE_SAMPLING_SCALE times its
+ *  size (so that large frames are not read entirely), then area-averaged. */
+const int SHOT_SIGNATURE_WIDTH = 32;
+const int SHOT_SIGNATURE_HEIGHT = 18;
+const int SHOT_SIGNATURE_SAMPLING_SCALE = 4;
+
+/** Mean absolute difference (0-255) between the signatures of consecutive frames above
+ *  which a new shot begins. */
+double SHOT_BOUNDARY_THRESHOLD = 30.0;
+
+/** Minimum number of frames of a shot (shorter ones, such as flashes, are merged). */
+int SHOT_MIN_FRAME_COUNT = 10;
+
+/** Tells if mode 0 detects the shot boundaries of the videos (off by default, until what
+ *  the detection adds to the extraction time is measured by the benchmark). */
+bool SHOT_DETECTION_ENABLED = false;
+
+/** Returns the path of the file with the shot boundaries of the video of file name
+ *  <videoFileName>, saved into the directory <dirPath> along with its frames. */
+string getShotBoundaryFilePath(string dirPath, string videoFileName) {
+    return dirPath + "/" + videoFileName + ".shots";
+}
+
+/** Returns the signature of the given frame <frame>, to be compared with the ones of its
+ *  neighbours. The reductions are vectorized by OpenCV. */
+Mat computeFrameSignature(Mat frame) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+
+    Mat sampledFrame, signature;
+    Size sampledSize(SHOT_SIGNATURE_WIDTH * SHOT_SIGNATURE_SAMPLING_SCALE,
+                     SHOT_SIGNATURE_HEIGHT * SHOT_SIGNATURE_SAMPLING_SCALE);
+    if (frame.cols > sampledSize.width && frame.rows > sampledSize.height)
+        resize(frame, sampledFrame, sampledSize, 0, 0, INTER_LINEAR);
+    else
+        sampledFrame = frame;
+    resize(sampledFrame, signature, Size(SHOT_SIGNATURE_WIDTH, SHOT_SIGNATURE_HEIGHT), 0, 0,
+           INTER_AREA);
+
+    recordStageTime(STAGE_SHOT_SIGNATURE, beginTime);
+    return signature;
+}
+
+/** Returns the mean absolute difference (0-255) between the frame signatures
+ *  <previousSignature> and <signature>. */
+float getFrameSignatureDifference(Mat previousSignature, Mat signature) {
+    return float(norm(previousSignature, signature, NORM_L1)
+                 / (signature.total() * signature.channels()));
+}
+
+/** Detects the shots of a video, given the differences <frameDifferences> between the
+ *  signature of each frame and the one of its previous frame, and lists the numbers of
+ *  their first frames in <shotBegins> (the first one being 0). Frames of unknown
+ *  difference (negative) are taken as part of the current shot. */
+void detectShotBoundaries(vector<float> *frameDifferences, vector<int> *shotBegins) {
+    shotBegins->clear();
+    if (frameDifferences->empty())
+        return;
+    shotBegins->push_back(0);
+
+    for (int i = 1; i < frameDifferences->size(); i++)
+        if (i - shotBegins->back() >= SHOT_MIN_FRAME_COUNT
+            && frameDifferences->at(i) > SHOT_BOUNDARY_THRESHOLD)
+            shotBegins->push_back(i);
+}
+
+/** Saves the given shot boundaries <shotBegins> into the file <shotFilePath>, one
+ *  first frame number per line. */
+void saveShotBoundaries(string shotFilePath, vector<int> *shotBegins) {
+    ofstream shotWriter(shotFilePath.data());
+    for (int shotBegin : *shotBegins)
+        shotWriter << shotBegin << endl;
+    shotWriter.close();
+
+    if (shotWriter.fail())
+        cerr << "WARNING: Could not save shot boundaries " << shotFilePath << "." << endl;
+}
+
+/** Loads the shot boundaries of the file <shotFilePath> into <shotBegins>. Returns FALSE
+ *  if there is no such file (in which case the video is taken as a single shot). */
+bool loadShotBoundaries(string shotFilePath, vector<int> *shotBegins) {
+    shotBegins->clear();
+    shotBegins->push_back(0);
+
+    ifstream shotReader(shotFilePath.data());
+    if (shotReader.fail())
+        return false;
+
+    int shotBegin;
+    while (shotReader >> shotBegin)
+        if (shotBegin > shotBegins->back())
+            shotBegins->push_back(shotBegin);
+    shotReader.close();
+    return true;
+}
+
+/** Returns the number of the first frame of the shot, among <shotBegins>, that
+ *  contains the frame of number <frameNumber>. */
+int getShotBegin(vector<int> *shotBegins, int frameNumber) {
+    return *std::prev(upper_bound(shotBegins->begin(), shotBegins->end(), frameNumber));
+}
+
+/** Returns the number of the frame right after the shot, among <shotBegins>, that
+ *  contains the frame of number <frameNumber>, or <frameCount> for the last shot. */
+int getShotEnd(vector<int> *shotBegins, int frameNumber, int frameCount) {
+    auto nextShotBegin = upper_bound(shotBegins->begin(), shotBegins->end(), frameNumber);
+    return nextShotBegin == shotBegins->end() ? frameCount : *nextShotBegin;
+}
+
+/** Returns the path of the file mapping the frames of the deduplicated video of file
+ *  name <videoFileName> to the frames kept for them, saved into the directory <dirPath>
+ *  along with its frames. */
+string getFrameDedupFilePath(string dirPath, string videoFileName) {
+    return dirPath + "/" + videoFileName + ".dedup";
+}
+
+/** Returns the perceptual hash (difference hash) of the frame of the given signature
+ *  <signature>: each bit tells if a pixel of its 9x8 grayscale reduction is darker than
+ *  its right neighbour, so similar frames have hashes at a small Hamming distance. */
+uint64_t computeFramePerceptualHash(Mat signature) {
+    Mat graySignature, hashPixels;
+    if (signature.channels() > 1)
+        cvtColor(signature, graySignature, COLOR_BGR2GRAY);
+    else
+        graySignature = signature;
+    resize(graySignature, hashPixels, Size(9, 8), 0, 0, INTER_AREA);
+
+    uint64_t hash = 0;
+    for (int row = 0; row < 8; row++)
+        for (int col = 0; col < 8; col++)
+            hash = (hash << 1)
+                   | (hashPixels.at<uchar>(row, col) < hashPixels.at<uchar>(row, col + 1) ? 1 : 0);
+    return hash;
+}
+
+/** Returns the Hamming distance between the perceptual hashes <hash1> and <hash2>. */
+int getPerceptualHashDistance(uint64_t hash1, uint64_t hash2) {
+    return bitset<64>(hash1 ^ hash2).count();
+}
+
+/** Map of the frames of a deduplicated video: its number of frames <frameCount> and the
+ *  numbers of the kept frames, in increasing order. Each kept frame stands for itself and
+ *  for the skipped frames up to the next kept one. Once deduplicated, the frames are
+ *  numbered by their positions in <keptFrameNumbers>. */
+struct FrameDedupMap {
+    int frameCount;
+    vector<int> keptFrameNumbers;
+};
+
+/** Saves the given map <dedupMap> into the file <dedupFilePath>: the number of frames of
+ *  the video, then the kept frame numbers, one per line. */
+void saveFrameDedupMap(string dedupFilePath, FrameDedupMap *dedupMap) {
+    ofstream dedupWriter(dedupFilePath.data());
+    dedupWriter << dedupMap->frameCount << endl;
+    for (int keptFrameNumber : dedupMap->keptFrameNumbers)
+        dedupWriter << keptFrameNumber << endl;
+    dedupWriter.close();
+
+    if (dedupWriter.fail())
+        cerr << "WARNING: Could not save frame map " << dedupFilePath << "." << endl;
+}
+
+/** Loads the map of the file <dedupFilePath> into <dedupMap>. Returns FALSE if there is
+ *  no such file (i.e., the frames were not deduplicated), or if it is not valid. */
+bool loadFrameDedupMap(string dedupFilePath, FrameDedupMap *dedupMap) {
+    dedupMap->frameCount = 0;
+    dedupMap->keptFrameNumbers.clear();
+
+    ifstream dedupReader(dedupFilePath.data());
+    if (!(dedupReader >> dedupMap->frameCount))
+        return false;
+
+    int keptFrameNumber;
+    while (dedupReader >> keptFrameNumber) {
+        if (keptFrameNumber >= dedupMap->frameCount
+            || (!dedupMap->keptFrameNumbers.empty()
+                && keptFrameNumber <= dedupMap->keptFrameNumbers.back()))
+            return false;
+        dedupMap->keptFrameNumbers.push_back(keptFrameNumber);
+    }
+    dedupReader.close();
+
+    return !dedupMap->keptFrameNumbers.empty() && dedupMap->keptFrameNumbers.front() == 0;
+}
+
+/** Returns the number, in the original video, of the deduplicated frame of number
+ *  <frameNumber>, according to <dedupMap>. The number right after the last
+ *  deduplicated frame is mapped to the number of frames of the video, so the ranges of
+ *  frames [begin, end) expand to the frames that they stand for. */
+int getOriginalFrameNumber(FrameDedupMap *dedupMap, int frameNumber) {
+    if (frameNumber >= dedupMap->keptFrameNumbers.size())
+        return dedupMap->frameCount;
+    return dedupMap->keptFrameNumbers.at(max(frameNumber, 0));
+}
+
+/** Returns the number of the deduplicated frame that stands for the frame of number
+ *  <originalFrameNumber> of the original video, according to <dedupMap>. */
+int getDedupFrameNumber(FrameDedupMap *dedupMap, int originalFrameNumber) {
+    auto nextKeptFrameNumber = upper_bound(dedupMap->keptFrameNumbers.begin(),
+                                           dedupMap->keptFrameNumbers.end(),
+                                           originalFrameNumber);
+    return max(int(nextKeptFrameNumber - dedupMap->keptFrameNumbers.begin()) - 1, 0);
+}
+
+/** Decoding stage of the frame extraction pipeline. Decodes the frames of numbers
+ *  [<firstFrameNumber>, <lastFrameNumber>) from the video stored in <videoFilePath>,
+ *  and hands them over to <outputFrameQueue>. A negative <lastFrameNumber> means
+ *  until the end of the video. A non-zero <firstFrameNumber> must be a key frame, so
+ *  the seek lands exactly on it.
+ *
+ *  Parameter <videoIndex> is the index of the video, of which timestamps tell if the
+ *  first and the last decoded frames are really the ones of numbers <firstFrameNumber>
+ *  and <lastFrameNumber> - 1.
+ *
+ *  Parameter <decodedFrameCount> outputs the number of decoded frames, or -1 if the
+ *  reader could not be positioned at <firstFrameNumber> (in which case no frame is
+ *  handed over), or if the decoded frames did not end at <lastFrameNumber>.
+ *
+ *  Parameter <frameDifferences> outputs, in the positions of their numbers, the
+ *  differences between the signatures of the decoded frames and the ones of their
+ *  previous frames (it must already have one position per video frame, with the
+ *  unknown differences being negative). Only the signatures of the first and last
+ *  decoded frames are kept, in <firstSignature> and <lastSignature>, so that the
+ *  differences across the segments of a video are computed once they are all decoded.
+ *
+ *  If <dedupHashDistance> is not negative, the frames of which perceptual hashes are
+ *  within that distance of the one of the last kept frame are not handed over, and
+ *  <frameRepresentatives> outputs, in the positions of their numbers, the numbers of
+ *  the kept frames that stand for them. */
+void decodeVideoFrames(string videoFilePath, int firstFrameNumber, int lastFrameNumber,
+                       VideoIndex *videoIndex, VideoFrameQueue *outputFrameQueue,
+                       int *decodedFrameCount, vector<float> *frameDifferences,
+                       Mat *firstSignature, Mat *lastSignature, int dedupHashDistance,
+                       vector<int> *frameRepresentatives) {
+    *decodedFrameCount = 0;
+
+    // video reader, positioned at the first wanted frame
+    VideoCapture *videoReader = new VideoCapture(videoFilePath);
+    if (firstFrameNumber > 0)
+        videoReader->set(CAP_PROP_POS_FRAMES, firstFrameNumber);
+
+    // last frame handed over, when deduplicating
+    int lastKeptFrameNumber = -1;
+    uint64_t lastKeptFrameHash = 0;
+
+    // extracts the frames
+    int frameNumber = firstFrameNumber;
+    while (*decodedFrameCount >= 0
+           && (lastFrameNumber < 0 || frameNumber < lastFrameNumber)) {
+        // a new matrix for every frame, since the previous one may still be queued
+        Mat currentFrame;
+        chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+        if (!videoReader->read(currentFrame))
+            break;
+        recordStageTime(STAGE_VIDEO_DECODE, beginTime);
+
+        // the seek must have landed on the first wanted frame
+        if (frameNumber == firstFrameNumber && firstFrameNumber > 0
+            && !isFrameDecoded(videoReader, videoIndex, firstFrameNumber)) {
+            *decodedFrameCount = -1;
+            break;
+        }
+
+        // signature of the frame, compared with the previous one to detect the shot
+        // boundaries (only the difference is kept, not to hold a signature per frame)
+        Mat signature;
+        if (SHOT_DETECTION_ENABLED || dedupHashDistance >= 0)
+            signature = computeFrameSignature(currentFrame);
+        if (SHOT_DETECTION_ENABLED && frameNumber < frameDifferences->size()) {
+            if (frameNumber == firstFrameNumber)
+                *firstSignature = signature;
+            else
+                frameDifferences->at(frameNumber) =
+                        getFrameSignatureDifference(*lastSignature, signature);
+            *lastSignature = signature;
+        }
+
+        // skips the frame if it is a near duplicate of the last kept one
+        if (dedupHashDistance >= 0 && frameNumber < frameRepresentatives->size()) {
+            uint64_t frameHash = computeFramePerceptualHash(signature);
+            if (lastKeptFrameNumber >= 0
+                && getPerceptualHashDistance(frameHash, lastKeptFrameHash) <= dedupHashDistance) {
+                frameRepresentatives->at(frameNumber) = lastKeptFrameNumber;
+                frameNumber++;
+                (*decodedFrameCount)++;
+                continue;
+            }
+
+            frameRepresentatives->at(frameNumber) = frameNumber;
+            lastKeptFrameNumber = frameNumber;
+            lastKeptFrameHash = frameHash;
+        }
+
+        // one more frame obtained
+        pushVideoFrame(outputFrameQueue, frameNumber, currentFrame);
+        frameNumber++;
+        (*decodedFrameCount)++;
+    }
+
+    // the last decoded frame must be the one right before the next segment
+    if (*decodedFrameCount > 0 && frameNumber == lastFrameNumber
+        && !isFrameDecoded(videoReader, videoIndex, lastFrameNumber - 1))
+        *decodedFrameCount = -1;
+    closeVideoFrameQueue(outputFrameQueue);
+
+    // frees memory
+    videoReader->release();
+    delete videoReader;
+}
+
+/** Returns TRUE if the video stored in <videoFilePath> can be sought to each one of the
+ *  segment begins <segmentBegins>, i.e., if the first frame decoded after each seek is
+ *  the sought one, according to the timestamps of the index <videoIndex>. */
+bool verifyVideoSegmentSeeks(string videoFilePath, VideoIndex *videoIndex,
+                             vector<int> *segmentBegins) {
+    VideoCapture videoReader(videoFilePath);
+
+    Mat frame;
+    for (int segmentBegin : *segmentBegins)
+        if (segmentBegin > 0) {
+            videoReader.set(CAP_PROP_POS_FRAMES, segmentBegin);
+            if (!videoReader.read(frame)
+                || !isFrameDecoded(&videoReader, videoIndex, segmentBegin))
+                return false;
+        }
+
+    videoReader.release();
+    return true;
+}
+
+/** Splits the video of <frameCount> frames and key frames <keyFrameNumbers> into up to
+ *  <segmentCount> segments of similar lengths, each one beginning at a key frame.
+ *  The first frame numbers of the segments are output in <segmentBegins>. */
+void splitVideoIntoSegments(int frameCount, vector<int> *keyFrameNumbers, int segmentCount,
+                            vector<int> *segmentBegins) {
+    segmentBegins->push_back(0);
+
+    for (int i = 1; i < segmentCount; i++) {
+        // key frame closest to the ideal begin of the current segment
+        int idealBegin = int(double(frameCount) * i / segmentCount);
+        auto keyFrame = lower_bound(keyFrameNumbers->begin(), keyFrameNumbers->end(),
+                                    idealBegin);
+        if (keyFrame == keyFrameNumbers->end()
+            || (keyFrame != keyFrameNumbers->begin()
+                && idealBegin - *(keyFrame - 1) < *keyFrame - idealBegin))
+            keyFrame--;
+
+        if (keyFrame != keyFrameNumbers->end() && *keyFrame > segmentBegins->back())
+            segmentBegins->push_back(*keyFrame);
+    }
+}
+
+/** Extracts all the frames from a given video, and saves them in the given directory.
+ *  It is recommended for the video to be in H.264 MPEG-4 format. The frames are output as
+ *  JPG images, named with the video file name + frame number + a sequence number (from
+ *  00000001 to N). The size of the saved frames can be informed as a new desired total
+ *  number of pixels per frame, or 0 if the original size shall be maintained. If the new
+ *  desired total number of pixels is greater than the original one, the sizes of the frames
+ *  are simply maintained.
+ *
+ *  The extraction runs as a pipeline: decoder threads decode the frames, resizing threads
+ *  resize them (if it is the case), and <encoderThreadCount> threads encode and save them.
+ *  The stages are joined by bounded queues of FRAME_EXTRACTION_QUEUE_SIZE frames, so the
+ *  decoders wait whenever the encoders fall behind.
+ *
+ *  If <segmentCount> is greater than one, the video is split into up to that many
+ *  key-frame-aligned segments, each one decoded by its own thread. The frame numbering is
+ *  the same as the one of a sequential extraction: the seek to every segment begin is
+ *  verified against the timestamps of the video index before any frame is saved (the
+ *  video is extracted sequentially otherwise), and if the segments still turn out not to
+ *  cover the video exactly (gaps or overlaps), its saved frames are removed and it is
+ *  extracted again, sequentially.
+ *
+ *  If <packFrames> is TRUE, the frames are packed into a single archive file
+ *  (<video file name>.fla), instead of being saved as individual JPG files.
+ *
+ *  The seek index of the video (<video file name>.fidx) is saved alongside the frames, as
+ *  well as its shot boundaries (<video file name>.shots), detected while decoding.
+ *
+ *  If <dedupHashDistance> is not negative, the frames nearly identical to the last kept
+ *  one (with perceptual hashes within that Hamming distance) are not saved, and the map
+ *  of the skipped frames to the kept ones is saved alongside the frames
+ *  (<video file name>.dedup). Each decoding segment begins with a kept frame. */
+void extractAndSaveVideoFrames(string videoFilePath, string frameDirPath,
+                               int totalPixelCount, int encoderThreadCount,
+                               int segmentCount, bool packFrames, int dedupHashDistance) {
+    // tries to open the given dir path to store the extracted i-frames
+    DIR *pDir;
+    pDir = opendir(frameDirPath.data());
+    if (pDir == NULL)
+        // tries to create the directory
+        mkdir(videoFilePath.data(), 0777);
+
+    pDir = opendir(frameDirPath.data());
+    if (pDir == NULL) {
+        cerr << "Could not open neither create directory " << frameDirPath
+             << "." << endl;
+        throw -1;
+    }
+    closedir(pDir);
+
+    // obtains the name of the original video file
+    vector <string> *videoFilePathTokens = new vector<string>;
+    split(*videoFilePathTokens, videoFilePath, is_any_of("/"));
+    string videoFileName = videoFilePathTokens->back();
+    videoFilePathTokens->clear();
+    delete videoFilePathTokens;
+
+    // loads (or builds) the index of the video, saving it alongside the frames
+    VideoIndex videoIndex;
+    loadVideoIndex(videoFilePath, getVideoIndexFilePath(frameDirPath, videoFileName),
+                   &videoIndex);
+    int frameCount = videoIndex.frameCount;
+
+    // splits the video into key-frame-aligned segments, if it is the case
+    vector<int> segmentBegins;
+    if (segmentCount > 1)
+        splitVideoIntoSegments(frameCount, &videoIndex.keyFrameNumbers, segmentCount,
+                               &segmentBegins);
+    else
+        segmentBegins.push_back(0);
+
+    // the segments are decoded in parallel only if the seeks land on their begins
+    if (segmentBegins.size() > 1
+        && !verifyVideoSegmentSeeks(videoFilePath, &videoIndex, &segmentBegins)) {
+        cerr << "WARNING: Video " << videoFilePath << " cannot be sought exactly;"
+             << " extracting it sequentially." << endl;
+        segmentBegins.assign(1, 0);
+    }
+    segmentCount = segmentBegins.size();
+
+    // queues joining the pipeline stages
+    VideoFrameQueue decodedFrameQueue, resizedFrameQueue;
+    openVideoFrameQueue(&decodedFrameQueue, FRAME_EXTRACTION_QUEUE_SIZE, segmentCount);
+    openVideoFrameQueue(&resizedFrameQueue, FRAME_EXTRACTION_QUEUE_SIZE, segmentCount);
+
+    // resizing stage, if the frames are to be resized;
+    // otherwise the decoded frames go straight to the encoders
+    vector <thread> resizingThreads;
+    VideoFrameQueue *encoderFrameQueue = &decodedFrameQueue;
+    if (totalPixelCount > 0) {
+        for (int i = 0; i < segmentCount; i++)
+            resizingThreads.emplace_back(resizeVideoFrames, &decodedFrameQueue,
+                                         &resizedFrameQueue, totalPixelCount);
+        encoderFrameQueue = &resizedFrameQueue;
+    }
+
+    // encoding stage
+    FrameArchiveWriter archiveWriter;
+    if (packFrames)
+        openFrameArchiveWriter(getFrameArchiveFilePath(frameDirPath, videoFileName),
+                               &archiveWriter);
+
+    vector <thread> encodingThreads;
+    for (int i = 0; i < encoderThreadCount; i++)
+        if (packFrames)
+            encodingThreads.emplace_back(encodeAndArchiveVideoFrames, encoderFrameQueue,
+                                         &archiveWriter);
+        else
+            encodingThreads.emplace_back(encodeAndSaveVideoFrames, encoderFrameQueue,
+                                         frameDirPath, videoFileName);
+
+    // decoding stage, one thread per segment
+    vector<int> decodedFrameCounts(segmentCount, 0);
+    vector<float> frameDifferences(frameCount, -1);
+    vector <Mat> firstSignatures(segmentCount), lastSignatures(segmentCount);
+    vector<int> frameRepresentatives(frameCount);
+    for (int i = 0; i < frameCount; i++)
+        frameRepresentatives.at(i) = i;
+
+    vector <thread> decodingThreads;
+    for (int i = 0; i < segmentCount; i++)
+        decodingThreads.emplace_back(decodeVideoFrames, videoFilePath, segmentBegins.at(i),
+                                     (i + 1 < segmentCount ? segmentBegins.at(i + 1) : -1),
+                                     &videoIndex, &decodedFrameQueue,
+                                     &decodedFrameCounts.at(i), &frameDifferences,
+                                     &firstSignatures.at(i), &lastSignatures.at(i),
+                                     dedupHashDistance, &frameRepresentatives);
+
+    // waits for all the stages to finish
+    for (auto &decodingThread: decodingThreads)
+        decodingThread.join();
+    for (auto &resizingThread: resizingThreads)
+        resizingThread.join();
+    for (auto &encodingThread: encodingThreads)
+        encodingThread.join();
+
+    if (packFrames)
+        closeFrameArchiveWriter(&archiveWriter, videoFileName);
+
+    // verifies that the segments covered the video without gaps or overlaps,
+    // i.e., that each segment decoded exactly the frames up to the next segment begin,
+    // ending with the frame of the timestamp right before it
+    if (segmentCount > 1) {
+        int segmentEnd = 0;
+        for (int i = 0; i < segmentCount; i++) {
+            if (segmentEnd != segmentBegins.at(i) || decodedFrameCounts.at(i) < 0)
+                break;
+            segmentEnd = segmentBegins.at(i) + decodedFrameCounts.at(i);
+        }
+
+        if (segmentEnd != frameCount) {
+            cerr << "WARNING: Segments of video " << videoFilePath
+                 << " do not match the sequential frame numbering;"
+                 << " extracting it sequentially." << endl;
+
+            // frames saved under wrong numbers must not outlive the new extraction
+            removeExtractedFrames(frameDirPath, videoFileName);
+            extractAndSaveVideoFrames(videoFilePath, frameDirPath, totalPixelCount,
+                                      encoderThreadCount, 1, packFrames, dedupHashDistance);
+            return;
+        }
+    }
+
+    // detects and saves the shot boundaries, joining the differences of the segments
+    if (SHOT_DETECTION_ENABLED) {
+        for (int i = 1; i < segmentCount; i++)
+            if (!lastSignatures.at(i - 1).empty() && !firstSignatures.at(i).empty())
+                frameDifferences.at(segmentBegins.at(i)) = getFrameSignatureDifference(
+                        lastSignatures.at(i - 1), firstSignatures.at(i));
+
+        vector<int> shotBegins;
+        detectShotBoundaries(&frameDifferences, &shotBegins);
+        saveShotBoundaries(getShotBoundaryFilePath(frameDirPath, videoFileName), &shotBegins);
+    }
+
+        // else, the shots of a previous extraction may not match the new frames
+    else
+        remove(getShotBoundaryFilePath(frameDirPath, videoFileName).data());
+
+    // saves the map of the skipped frames, or removes the one of a previous extraction
+    string dedupFilePath = getFrameDedupFilePath(frameDirPath, videoFileName);
+    if (dedupHashDistance >= 0) {
+        FrameDedupMap dedupMap;
+        dedupMap.frameCount = frameCount;
+        for (int i = 0; i < frameCount; i++)
+            if (frameRepresentatives.at(i) == i)
+                dedupMap.keptFrameNumbers.push_back(i);
+        saveFrameDedupMap(dedupFilePath, &dedupMap);
+    } else
+        remove(dedupFilePath.data());
+}
+
+/** Reads a given input file and obtains a list with the file paths of the frames
+ *  previously extracted from a video to be annotated. */
+void readFrameFilePaths(string inputFilePath, vector <string> *frameFilePaths) {
+    ifstream fileReader;
+    fileReader.open(inputFilePath.data());
+    if (fileReader.fail()) {
+        cerr << "Could not open file " << inputFilePath << "." << endl;
+        throw -1;
+    }
+
+    // blank lines are skipped
+    string line;
+    while (getline(fileReader, line)) {
+        trim(line);
+        if (line.length() > 0)
+            frameFilePaths->push_back(line);
+    }
+
+    fileReader.close();
+}
+
+/** Source of the frames of the video being annotated: either a list of frame files
+ *  previously extracted, a memory-mapped packed frame archive, or the video file
+ *  itself, decoded on demand. */
+struct VideoFrameSource {
+    string videoFileName;
+    int frameCount;
+
+    // size of the frames, given to the black ones shown in place of missing frames
+    Size frameSize;
+
+    // directory of the frames (or of the video file), where their side files are kept
+    string frameDirPath;
+
+    // map of the kept frames, if the frames were deduplicated in mode 0 (in which case
+    // the frames are numbered by their positions among the kept ones)
+    bool deduplicated;
+    FrameDedupMap dedupMap;
+
+    // frame files, if the source is a list of them
+    vector <string> frameFilePaths;
+
+    // mapped archive, if the source is a packed frame archive
+    const uchar *archiveData;
+    size_t archiveSize;
+    const FrameArchiveIndexEntry *archiveIndex;
+
+    // video reader, if the source is the video file itself
+    string videoFilePath;
+    VideoCapture *videoReader;
+    VideoIndex videoIndex;
+    int nextVideoFrameNumber; // number of the frame the reader will decode next
+    mutex videoReaderMutex;
+
+    // TRUE once the user asks to quit the annotation
+    atomic<bool> closed;
+};
+
+/** Returns TRUE if the given file <filePath> is a packed frame archive. */
+bool isFrameArchive(string filePath) {
+    char magic[sizeof(FRAME_ARCHIVE_MAGIC)];
+
+    FILE *file = fopen(filePath.data(), "rb");
+    if (file == NULL)
+        return false;
+    size_t readCount = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    return readCount == sizeof(magic)
+           && memcmp(magic, FRAME_ARCHIVE_MAGIC, sizeof(magic)) == 0;
+}
+
+/** Returns TRUE if the given file <filePath> is a list of frame files, i.e., if its first
+ *  non-blank line is the path of a readable image. Only the beginning of the file is
+ *  read, since it may well be a large video. */
+bool isFrameList(string filePath) {
+    char beginning[4096];
+
+    FILE *file = fopen(filePath.data(), "rb");
+    if (file == NULL)
+        return false;
+    size_t readCount = fread(beginning, 1, sizeof(beginning), file);
+    fclose(file);
+
+    vector <string> lines;
+    string beginningText(beginning, readCount);
+    split(lines, beginningText, is_any_of("\n"));
+    for (string &line : lines) {
+        trim(line);
+        if (line.length() > 0) {
+            struct stat frameFileStat;
+            return stat(line.data(), &frameFileStat) == 0 && S_ISREG(frameFileStat.st_mode)
+                   && haveImageReader(line);
+        }
+    }
+    return false;
+}
+
+/** Maps the packed frame archive <archiveFilePath> into memory, as the given
+ *  frame source <frameSource>. The header and every index entry are validated, so that
+ *  no frame is read beyond the mapping; frames without entry (of size 0) are missing. */
+void mapFrameArchive(string archiveFilePath, VideoFrameSource *frameSource) {
+    int archiveDescriptor = open(archiveFilePath.data(), O_RDONLY);
+    struct stat archiveStat;
+    if (archiveDescriptor < 0 || fstat(archiveDescriptor, &archiveStat) != 0) {
+        cerr << "Could not open file " << archiveFilePath << "." << endl;
+        throw -1;
+    }
+
+    void *archiveData = mmap(NULL, archiveStat.st_size, PROT_READ, MAP_SHARED,
+                             archiveDescriptor, 0);
+    close(archiveDescriptor);
+    if (archiveData == MAP_FAILED) {
+        cerr << "Could not map file " << archiveFilePath << "." << endl;
+        throw -1;
+    }
+
+    frameSource->archiveData = (const uchar *) archiveData;
+    frameSource->archiveSize = archiveStat.st_size;
+
+    // validates the header and the index
+    const FrameArchiveHeader *header = (const FrameArchiveHeader *) frameSource->archiveData;
+    if (frameSource->archiveSize < sizeof(FrameArchiveHeader)
+        || header->indexOffset > frameSource->archiveSize
+        || header->frameCount > (frameSource->archiveSize - header->indexOffset)
+                                / sizeof(FrameArchiveIndexEntry)) {
+        cerr << "File " << archiveFilePath << " is not a valid frame archive." << endl;
+        throw -2;
+    }
+
+    frameSource->archiveIndex = (const FrameArchiveIndexEntry *)
+            (frameSource->archiveData + header->indexOffset);
+    frameSource->frameSize = Size(0, 0);
+    for (uint64_t i = 0; i < header->frameCount; i++) {
+        const FrameArchiveIndexEntry *entry = &frameSource->archiveIndex[i];
+        if (entry->size > header->indexOffset
+            || entry->offset > header->indexOffset - entry->size) {
+            munmap((void *) frameSource->archiveData, frameSource->archiveSize);
+            frameSource->archiveData = NULL;
+            cerr << "File " << archiveFilePath << " is not a valid frame archive." << endl;
+            throw -2;
+        }
+
+        // the first present frame tells the size of all of them
+        if (entry->size > 0 && frameSource->frameSize.area() == 0) {
+            Mat encodedFrame(1, int(entry->size), CV_8U,
+                             (void *) (frameSource->archiveData + entry->offset));
+            frameSource->frameSize = imdecode(encodedFrame, IMREAD_COLOR).size();
+        }
+    }
+    frameSource->frameCount = header->frameCount;
+    frameSource->videoFileName = string(header->videoFileName,
+                                        strnlen(header->videoFileName,
+                                                sizeof(header->videoFileName)));
+}
+
+/** Opens the video file <videoFilePath> as the given frame source <frameSource>.
+ *  The frames are numbered as they would be by extractAndSaveVideoFrames(). The seek
+ *  index of the video is kept alongside it (<video file path>.fidx). */
+void openVideoFileFrameSource(string videoFilePath, VideoFrameSource *frameSource) {
+    frameSource->videoFilePath = videoFilePath;
+    loadVideoIndex(videoFilePath, videoFilePath + ".fidx", &frameSource->videoIndex);
+    frameSource->frameCount = frameSource->videoIndex.frameCount;
+
+    frameSource->videoReader = new VideoCapture(videoFilePath);
+    frameSource->nextVideoFrameNumber = 0;
+    frameSource->frameSize = Size(
+            int(frameSource->videoReader->get(CAP_PROP_FRAME_WIDTH)),
+            int(frameSource->videoReader->get(CAP_PROP_FRAME_HEIGHT)));
+
+    // obtains the video file name
+    vector <string> tokens;
+    split(tokens, videoFilePath, is_any_of("/"));
+    frameSource->videoFileName = tokens.back();
+    tokens.clear();
+}
+
+/** Returns the path of the directory of the file <filePath>. */
+string getDirPath(string filePath) {
+    size_t separatorPosition = filePath.rfind('/');
+    return separatorPosition == string::npos ? "." : filePath.substr(0, separatorPosition);
+}
+
+/** Opens the frames of the video to be annotated, as the given frame source
+ *  <frameSource>. The given input file <inputFilePath> is either a packed frame
+ *  archive, a text file with the file paths of the frames, one per line, or a video
+ *  file (only tried as such once it is neither of the others, since some video readers
+ *  open text files too). */
+void openVideoFrameSource(string inputFilePath, VideoFrameSource *frameSource) {
+    frameSource->archiveData = NULL;
+    frameSource->archiveSize = 0;
+    frameSource->archiveIndex = NULL;
+    frameSource->videoReader = NULL;
+    frameSource->deduplicated = false;
+    frameSource->closed = false;
+
+    if (isFrameArchive(inputFilePath)) {
+        mapFrameArchive(inputFilePath, frameSource);
+        frameSource->frameDirPath = getDirPath(inputFilePath);
+
+        // only the kept frames are in the archive, if they were deduplicated
+        if (loadFrameDedupMap(getFrameDedupFilePath(frameSource->frameDirPath,
+                                                    frameSource->videoFileName),
+                              &frameSource->dedupMap)
+            && frameSource->dedupMap.keptFrameNumbers.back() < frameSource->frameCount) {
+            frameSource->deduplicated = true;
+            frameSource->frameCount = frameSource->dedupMap.keptFrameNumbers.size();
+        }
+    }
+
+    else if (isFrameList(inputFilePath)) {
+        // obtains a list with the file paths to the frames of the video to be annotated
+        readFrameFilePaths(inputFilePath, &frameSource->frameFilePaths);
+        if (frameSource->frameFilePaths.empty()) {
+            cerr << "File " << inputFilePath << " does not list any frame." << endl;
+            throw -2;
+        }
+        frameSource->frameCount = frameSource->frameFilePaths.size();
+        frameSource->frameDirPath = getDirPath(frameSource->frameFilePaths.front());
+
+        // obtains the video file name, stripping the frame number off the frame file name
+        // (the video file name may have dashes of its own)
+        vector <string> tokens;
+        split(tokens, frameSource->frameFilePaths.front(), is_any_of("/"));
+        frameSource->videoFileName = tokens.back();
+        tokens.clear();
+
+        if (getFrameFileNumber(frameSource->videoFileName) >= 0)
+            frameSource->videoFileName = frameSource->videoFileName.substr(
+                    0, frameSource->videoFileName.rfind('-'));
+
+        // only the kept frames are annotated, if they were deduplicated; they are picked
+        // out of the list by the frame numbers of their file names, so frames left behind
+        // by other extractions do not shift the numbering
+        if (loadFrameDedupMap(getFrameDedupFilePath(frameSource->frameDirPath,
+                                                    frameSource->videoFileName),
+                              &frameSource->dedupMap)) {
+            map<int, string> listedFrameFilePaths;
+            for (string &frameFilePath : frameSource->frameFilePaths)
+                listedFrameFilePaths[getFrameFileNumber(frameFilePath)] = frameFilePath;
+
+            vector <string> keptFrameFilePaths;
+            for (int keptFrameNumber : frameSource->dedupMap.keptFrameNumbers) {
+                auto listedFrameFilePath = listedFrameFilePaths.find(keptFrameNumber);
+                if (listedFrameFilePath == listedFrameFilePaths.end()) {
+                    cerr << "Frame " << keptFrameNumber << " of video "
+                         << frameSource->videoFileName << " is in its frame map, but not in "
+                         << inputFilePath << "." << endl;
+                    throw -2;
+                }
+                keptFrameFilePaths.push_back(listedFrameFilePath->second);
+            }
+
+            frameSource->frameFilePaths = keptFrameFilePaths;
+            frameSource->frameCount = keptFrameFilePaths.size();
+            frameSource->deduplicated = true;
+        }
+    }
+
+    else if (VideoCapture(inputFilePath).isOpened()) {
+        openVideoFileFrameSource(inputFilePath, frameSource);
+        frameSource->frameDirPath = getDirPath(inputFilePath);
+    }
+
+    else {
+        cerr << "Could not open file " << inputFilePath << " as a frame archive, a frame "
+             << "list or a video." << endl;
+        throw -1;
+    }
+}
+
+/** Decodes the frame of number <frameNumber> from the video file of the given frame
+ *  source <frameSource>. If the frame is not the next one to be decoded, the reader
+ *  seeks to the closest preceding key frame and decodes forward from it (unless
+ *  decoding forward from the current position is shorter). A seek is trusted only if the
+ *  frame it lands on has the timestamp of the key frame in the video index; otherwise
+ *  the reader decodes forward from the beginning, so the frames keep the numbering of
+ *  extractAndSaveVideoFrames(). */
+Mat readVideoFileFrame(VideoFrameSource *frameSource, int frameNumber) {
+    lock_guard <mutex> videoReaderLock(frameSource->videoReaderMutex);
+
+    if (frameNumber < 0 || frameNumber >= frameSource->frameCount)
+        throw out_of_range("frame number out of the video");
+
+    // closest key frame at or before the wanted frame
+    vector<int> *keyFrameNumbers = &frameSource->videoIndex.keyFrameNumbers;
+    auto keyFrame = upper_bound(keyFrameNumbers->begin(), keyFrameNumbers->end(),
+                                frameNumber);
+    int keyFrameNumber = (keyFrame == keyFrameNumbers->begin() ?
+                          0 : *(keyFrame - 1));
+
+    // seeks, if the wanted frame is behind the reader or beyond the next key frame
+    bool frameGrabbed = false;
+    if (frameNumber < frameSource->nextVideoFrameNumber
+        || keyFrameNumber > frameSource->nextVideoFrameNumber) {
+        frameSource->videoReader->set(CAP_PROP_POS_FRAMES, keyFrameNumber);
+
+        // the reader did not land on the key frame: restarts from the beginning
+        if (frameSource->videoReader->grab()
+            && isFrameDecoded(frameSource->videoReader, &frameSource->videoIndex,
+                              keyFrameNumber)) {
+            frameSource->nextVideoFrameNumber = keyFrameNumber + 1;
+            frameGrabbed = (keyFrameNumber == frameNumber);
+        } else {
+            frameSource->videoReader->release();
+            frameSource->videoReader->open(frameSource->videoFilePath);
+            frameSource->nextVideoFrameNumber = 0;
+        }
+    }
+
+    // decodes forward, up to the wanted frame
+    while (!frameGrabbed && frameSource->nextVideoFrameNumber <= frameNumber
+           && frameSource->videoReader->grab()) {
+        frameSource->nextVideoFrameNumber++;
+        frameGrabbed = (frameSource->nextVideoFrameNumber == frameNumber + 1);
+    }
+
+    Mat frame;
+    if (!frameGrabbed || !frameSource->videoReader->retrieve(frame))
+        // undecodable frame (e.g., a trailing broken packet): shows it black
+        frame = Mat::zeros(frameSource->frameSize, CV_8UC3);
+
+    return frame;
+}
+
+/** Returns the image reading flag that decodes a frame straight to 1/<scale> of its
+ *  size (with <scale> being 1, 2, 4 or 8), which JPEG decoding does cheaply by scaling
+ *  the DCT. */
+int getReducedImreadFlag(int scale) {
+    switch (scale) {
+        case 2:
+            return IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return IMREAD_REDUCED_COLOR_8;
+        default:
+            return IMREAD_COLOR;
+    }
+}
+
+/** Reads and decodes the frame of number <frameNumber> from the given frame source
+ *  <frameSource>, reduced to 1/<scale> of its size (with <scale> being 1, 2, 4 or 8).
+ *  Archived frames are decoded straight from the mapped bytes. Frames of video files
+ *  are decoded at full size and then shrunk, since video codecs do not scale while
+ *  decoding. */
+Mat readVideoFrame(VideoFrameSource *frameSource, int frameNumber, int scale) {
+    if (frameSource->videoReader != NULL) {
+        Mat frame = readVideoFileFrame(frameSource, frameNumber);
+        if (scale > 1)
+            resize(frame, frame, Size(), 1.0 / scale, 1.0 / scale, INTER_AREA);
+        return frame;
+    }
+
+    if (frameSource->archiveData == NULL)
+        return imread(frameSource->frameFilePaths.at(frameNumber), getReducedImreadFlag(scale));
+
+    if (frameNumber < 0 || frameNumber >= frameSource->frameCount)
+        throw out_of_range("frame number out of the archive");
+
+    int archiveFrameNumber = (frameSource->deduplicated ?
+                              frameSource->dedupMap.keptFrameNumbers.at(frameNumber) : frameNumber);
+    const FrameArchiveIndexEntry *entry = &frameSource->archiveIndex[archiveFrameNumber];
+
+    Mat frame;
+    if (entry->size > 0) {
+        Mat encodedFrame(1, int(entry->size), CV_8U,
+                         (void *) (frameSource->archiveData + entry->offset));
+        frame = imdecode(encodedFrame, getReducedImreadFlag(scale));
+    }
+
+    // missing or undecodable frame: shows it black
+    if (frame.empty())
+        frame = Mat::zeros(frameSource->frameSize.height / scale,
+                           frameSource->frameSize.width / scale, CV_8UC3);
+    return frame;
+}
+
+/** Releases the resources held by the given frame source <frameSource>. */
+void closeVideoFrameSource(VideoFrameSource *frameSource) {
+    if (frameSource->archiveData != NULL)
+        munmap((void *) frameSource->archiveData, frameSource->archiveSize);
+    frameSource->archiveData = NULL;
+    frameSource->archiveIndex = NULL;
+    frameSource->frameFilePaths.clear();
+
+    if (frameSource->videoReader != NULL) {
+        frameSource->videoReader->release();
+        delete frameSource->videoReader;
+    }
+    frameSource->videoReader = NULL;
+}
+
+/** Obtains the metadata <videoMetadata> of the video of the given frame source
+ *  <frameSource> from the video catalog: the video file itself, the video indexed
+ *  alongside the extracted frames (by its path), or else a catalogued video of the
+ *  same file name. Returns FALSE if the video cannot be told. */
+bool getFrameSourceVideoMetadata(VideoFrameSource *frameSource,
+                                 VideoMetadata *videoMetadata) {
+    if (frameSource->videoReader != NULL)
+        return getVideoMetadata(&VIDEO_CATALOG, frameSource->videoFilePath, videoMetadata);
+
+    string videoFilePath;
+    if (loadIndexedVideoFilePath(getVideoIndexFilePath(frameSource->frameDirPath,
+                                                       frameSource->videoFileName),
+                                 &videoFilePath)
+        && getVideoMetadata(&VIDEO_CATALOG, videoFilePath, videoMetadata))
+        return true;
+
+    return findVideoMetadataByName(&VIDEO_CATALOG, frameSource->videoFileName, videoMetadata);
+}
+
+/** Label of the frames annotated as negative. */
+const int NEGATIVE_LABEL = 0;
+
+/** Label of the frames annotated as positive. */
+const int POSITIVE_LABEL = 1;
+
+/** Label of the frames not annotated yet. */
+const int NO_LABEL = -1;
+
+/** Run-length store of the labels of the frames of a video. Each run of consecutive
+ *  frames with the same label is a single entry of <labelRuns>, keyed by the number
+ *  of its first frame; the runs cover the frames [0, <frameCount>), and neighbouring
+ *  runs always have different labels. */
+struct FrameLabelStore {
+    int frameCount;
+    map<int, int> labelRuns;
+};
+
+/** Prepares the given store <labelStore> for <frameCount> frames, all of them with
+ *  the given label <label>. */
+void initFrameLabelStore(FrameLabelStore *labelStore, int frameCount, int label) {
+    labelStore->frameCount = frameCount;
+    labelStore->labelRuns.clear();
+    if (frameCount > 0)
+        labelStore->labelRuns[0] = label;
+}
+
+/** Returns the label of the frame of number <frameNumber>, from the given store
+ *  <labelStore>. */
+int getFrameLabel(FrameLabelStore *labelStore, int frameNumber) {
+    if (frameNumber < 0 || frameNumber >= labelStore->frameCount)
+        return NO_LABEL;
+
+    return std::prev(labelStore->labelRuns.upper_bound(frameNumber))->second;
+}
+
+/** Returns the number of the first frame of the run of equally labeled frames that
+ *  contains the frame of number <frameNumber>. */
+int getLabelRunBegin(FrameLabelStore *labelStore, int frameNumber) {
+    return std::prev(labelStore->labelRuns.upper_bound(frameNumber))->first;
+}
+
+/** Returns the number of the frame right after the run of equally labeled frames that
+ *  contains the frame of number <frameNumber>. */
+int getLabelRunEnd(FrameLabelStore *labelStore, int frameNumber) {
+    auto nextRun = labelStore->labelRuns.upper_bound(frameNumber);
+    return nextRun == labelStore->labelRuns.end() ? labelStore->frameCount : nextRun->first;
+}
+
+/** Gives the label <label> to the frames [<firstFrameNumber>, <lastFrameNumber>) of
+ *  the given store <labelStore>. */
+void setFrameLabels(FrameLabelStore *labelStore, int firstFrameNumber, int lastFrameNumber,
+                    int label) {
+    firstFrameNumber = max(firstFrameNumber, 0);
+    lastFrameNumber = min(lastFrameNumber, labelStore->frameCount);
+    if (firstFrameNumber >= lastFrameNumber)
+        return;
+
+    map<int, int> *labelRuns = &labelStore->labelRuns;
+
+    // the frames after the range keep their label, in a run of their own
+    if (lastFrameNumber < labelStore->frameCount)
+        (*labelRuns)[lastFrameNumber] = getFrameLabel(labelStore, lastFrameNumber);
+
+    // replaces the runs inside the range by a single one
+    labelRuns->erase(labelRuns->lower_bound(firstFrameNumber),
+                     labelRuns->lower_bound(lastFrameNumber));
+    auto run = labelRuns->emplace(firstFrameNumber, label).first;
+
+    // merges the new run with its neighbours, if they have the same label
+    auto nextRun = std::next(run);
+    if (nextRun != labelRuns->end() && nextRun->second == label)
+        labelRuns->erase(nextRun);
+    if (run != labelRuns->begin() && std::prev(run)->second == label)
+        labelRuns->erase(run);
+}
+
+/** Segment of an ETF file, annotating a video from <beginTime> during <duration>
+ *  seconds, as positive or not. */
+struct ETFSegment {
+    double beginTime, duration;
+    bool positive;
+};
+
+/** Index of the segments of an ETF file, by the name of the video they annotate (in
+ *  the order they appear in the file). It is built in a single pass, so that the
+ *  annotations of many videos can be taken from the same file. */
+struct ETFIndex {
+    unordered_map<string, vector<ETFSegment>> videoSegments;
+};
+
+/** Returns the whitespace-delimited token that begins at or after <position>, in the
+ *  line ending at <lineEnd>, and moves <position> past it. */
+string readETFToken(const char **position, const char *lineEnd) {
+    const char *tokenBegin = *position;
+    while (tokenBegin < lineEnd && (*tokenBegin == ' ' || *tokenBegin == '\t'))
+        tokenBegin++;
+
+    const char *tokenEnd = tokenBegin;
+    while (tokenEnd < lineEnd && *tokenEnd != ' ' && *tokenEnd != '\t' && *tokenEnd != '\r')
+        tokenEnd++;
+
+    *position = tokenEnd;
+    return string(tokenBegin, tokenEnd);
+}
+
+/** Parses the given token <token> as a number into <number>. Returns FALSE if the
+ *  token is not entirely a number. */
+bool parseETFNumber(string token, double *number) {
+    char *numberEnd;
+    *number = strtod(token.data(), &numberEnd);
+    return !token.empty() && *numberEnd == '\0';
+}
+
+/** Indexes the ETF file <etfFilePath> into <etfIndex>. The file is mapped into memory
+ *  and parsed in a single pass; video names are matched exactly later on. */
+void loadETFIndex(string etfFilePath, ETFIndex *etfIndex) {
+    int etfDescriptor = open(etfFilePath.data(), O_RDONLY);
+    struct stat etfStat;
+    if (etfDescriptor < 0 || fstat(etfDescriptor, &etfStat) != 0) {
+        if (etfDescriptor >= 0)
+            close(etfDescriptor);
+        cerr << "Could not open file " << etfFilePath << "." << endl;
+        throw -1;
+    }
+
+    etfIndex->videoSegments.clear();
+    if (etfStat.st_size == 0) {
+        close(etfDescriptor);
+        return;
+    }
+
+    void *etfData = mmap(NULL, etfStat.st_size, PROT_READ, MAP_PRIVATE, etfDescriptor, 0);
+    close(etfDescriptor);
+    if (etfData == MAP_FAILED) {
+        cerr << "Could not map file " << etfFilePath << "." << endl;
+        throw -1;
+    }
+    madvise(etfData, etfStat.st_size, MADV_SEQUENTIAL);
+
+    const char *etfBegin = (const char *) etfData;
+    const char *etfEnd = etfBegin + etfStat.st_size;
+
+    // segments of the video of the previous line (ETF files are usually grouped by video)
+    string lastVideoName;
+    vector<ETFSegment> *lastVideoSegments = NULL;
+
+    bool validETF = true;
+    for (const char *lineBegin = etfBegin; lineBegin < etfEnd && validETF;) {
+        const char *lineEnd = (const char *) memchr(lineBegin, '\n', etfEnd - lineBegin);
+        if (lineEnd == NULL)
+            lineEnd = etfEnd;
+
+        // video channel begin duration event - event_name - label
+        const char *position = lineBegin;
+        string videoName = readETFToken(&position, lineEnd);
+        if (!videoName.empty() && videoName[0] != '#') {
+            ETFSegment segment;
+            string label;
+            readETFToken(&position, lineEnd);
+            validETF = parseETFNumber(readETFToken(&position, lineEnd), &segment.beginTime)
+                       && parseETFNumber(readETFToken(&position, lineEnd), &segment.duration);
+            for (int i = 0; i < 5; i++)
+                label = readETFToken(&position, lineEnd);
+            validETF = validETF && !label.empty();
+            segment.positive = (label == "t");
+
+            if (lastVideoSegments == NULL || videoName != lastVideoName) {
+                lastVideoName = videoName;
+                lastVideoSegments = &etfIndex->videoSegments[videoName];
+            }
+            lastVideoSegments->push_back(segment);
+        }
+
+        lineBegin = lineEnd + 1;
+    }
+
+    munmap(etfData, etfStat.st_size);
+    if (!validETF) {
+        cerr << "File " << etfFilePath << " is not a valid ETF one." << endl;
+        throw -2;
+    }
+}
+
+/** Returns the frame intervals annotated in the given ETF index <etfIndex> for the video
+ *  of file name <videoFileName>, with frame rate <videoFPS>. Each interval of
+ *  <frameIntervals> is given as [begin, end) frame numbers, and its label is given by
+ *  the same position of <intervalLabels>. */
+void getETFFrameIntervals(ETFIndex *etfIndex, string videoFileName, double videoFPS,
+                          vector <pair<int, int>> *frameIntervals, vector<int> *intervalLabels) {
+    frameIntervals->clear();
+    intervalLabels->clear();
+
+    auto videoSegments = etfIndex->videoSegments.find(videoFileName);
+    if (videoSegments == etfIndex->videoSegments.end())
+        return;
+
+    for (ETFSegment &segment: videoSegments->second) {
+        double firstFrameNumber = segment.beginTime * videoFPS;
+        double lastFrameNumber = firstFrameNumber + segment.duration * videoFPS;
+
+        frameIntervals->push_back(make_pair(int(round(firstFrameNumber)),
+                                            int(ceil(lastFrameNumber))));
+        intervalLabels->push_back(segment.positive ? POSITIVE_LABEL : NEGATIVE_LABEL);
+    }
+}
+
+/** Reads the content of a given ETF file, regarding the annotation of a video
+ *  of interest, of which file name is given as a parameter.
+ *
+ *  The frame rate of the video must also be informed, in terms of FPS.
+ *
+ *  Parameter <frameLabels> outputs the labels of the frames marked as positive
+ *  or negative in the ETF file; the other frames keep their labels.
+ *
+ *  ETF file: format created within the MediaEval (https://multimediaeval.github.io/)
+ *  violent scenes localization task. */
+void readInputETFFile(string videoFileName, double videoFPS, string etfFilePath,
+                      FrameLabelStore *frameLabels) {
+    ETFIndex etfIndex;
+    loadETFIndex(etfFilePath, &etfIndex);
+
+    // labels the positive or negative frames
+    vector <pair<int, int>> frameIntervals;
+    vector<int> intervalLabels;
+    getETFFrameIntervals(&etfIndex, videoFileName, videoFPS, &frameIntervals, &intervalLabels);
+    for (int i = 0; i < frameIntervals.size(); i++)
+        setFrameLabels(frameLabels, frameIntervals.at(i).first, frameIntervals.at(i).second,
+                       intervalLabels.at(i));
+}
+
+/** Generates and saves the ETF file in the given path <etfFilePath>.
+ *
+ *  Parameter <event> is a string containing the name of annotated event.
+ *
+ *  Parameter <videoFPS> defines the frame rate of the annotated video.
+ *
+ *  Parameter <videoFileName> contains the file name of the annotated video.
+ *
+ *  Parameter <frameLabels> is the store of the labels of the annotated frames (and
+ *  also tells the total number of frames extracted from the annotated video). Frames
+ *  without label are given the label of the first labeled frame of the video.
+ *
+ *  Parameter <dedupMap> is the map of the kept frames, if the annotated frames were
+ *  deduplicated (NULL otherwise): the label of each kept frame is expanded to the
+ *  frames that it stands for, so the ETF file refers to the original video frames.
+ *
+ *  ETF file: format created within the MediaEval (https://multimediaeval.github.io/ violent scenes loc. task. */
+void generateAndSaveETFFile(string etfFilePath, string event, double videoFPS,
+                            string videoFileName, FrameLabelStore *frameLabels,
+                            FrameDedupMap *dedupMap) {
+    // label given to the frames without one
+    int missingLabel = NEGATIVE_LABEL;
+    for (auto &run: frameLabels->labelRuns)
+        if (run.second != NO_LABEL) {
+            missingLabel = run.second;
+            break;
+        }
+
+    // holds the runs of the output labels, as [begin, end) frame numbers
+    vector <pair<int, int>> labelRunBounds;
+    vector<int> labelRunLabels;
+    for (auto run = frameLabels->labelRuns.begin(); run != frameLabels->labelRuns.end(); run++) {
+        int label = (run->second == NO_LABEL ? missingLabel : run->second);
+        int runBegin = run->first;
+        int runEnd = getLabelRunEnd(frameLabels, run->first);
+
+        // the runs of deduplicated frames expand to the original ones
+        if (dedupMap != NULL) {
+            runBegin = getOriginalFrameNumber(dedupMap, runBegin);
+            runEnd = getOriginalFrameNumber(dedupMap, runEnd);
+        }
+
+        // unlabeled runs may join their neighbours
+        if (!labelRunLabels.empty() && labelRunLabels.back() == label)
+            labelRunBounds.back().second = runEnd;
+        else {
+            labelRunBounds.push_back(make_pair(runBegin, runEnd));
+            labelRunLabels.push_back(label);
+        }
+    }
+
+    // ETF file writer
+    ofstream etfFileWriter(etfFilePath.data());
+    if (etfFileWriter.fail()) {
+        cerr << "Could not write file " << etfFilePath << "." << endl;
+        throw -1;
+    }
+
+    for (int i = 0; i < labelRunBounds.size(); i++) {
+        double time = labelRunBounds.at(i).first / videoFPS;
+        double duration = (labelRunBounds.at(i).second / videoFPS) - time;
+
+        if (duration > 0) {
+            etfFileWriter << videoFileName << " 1 " << time << " " << duration
+                          << " event - " << event << " - "
+                          << (labelRunLabels.at(i) == POSITIVE_LABEL ? 't' : 'f') << endl;
+        }
+    }
+
+    // adds the numbers of the positive frames to the ETF file as comments
+    // (a little help to non-ETF format enthusiasts)
+    bool hasPositiveFrames = false;
+    for (int i = 0; i < labelRunBounds.size(); i++)
+        if (labelRunLabels.at(i) == POSITIVE_LABEL) {
+            if (!hasPositiveFrames)
+                etfFileWriter << "# positive frames" << endl;
+            hasPositiveFrames = true;
+
+            for (int j = labelRunBounds.at(i).first; j < labelRunBounds.at(i).second; j++)
+                etfFileWriter << "# " << j << endl;
+        }
+
+    // closes the ETF file
+    etfFileWriter.close();
+}
+
+/** Returns TRUE if there is a file in the given path <filePath>. */
+bool fileExists(string filePath) {
+    struct stat fileStat;
+    return stat(filePath.data(), &fileStat) == 0;
+}
+
+/** Append-only journal of the label changes of an annotation session, kept next to
+ *  the output ETF file (<ETF file path>.journal). Each line is a record, either
+ *  "L <first frame> <last frame (exclusive)> <label>" for a label change, or
+ *  "P <frame number>" for the position where the annotator was. A background thread
+ *  periodically compacts the journal into the output ETF file, and rewrites the
+ *  journal with the label runs of that moment. If the session crashes, the journal
+ *  is replayed in the next one. */
+struct LabelJournal {
+    string journalFilePath;
+    ofstream journalWriter;
+
+    // store of the labels, only changed through the journal
+    FrameLabelStore *frameLabels;
+    int lastFrameNumber;
+
+    // records appended since the last snapshot of the labels
+    vector <string> pendingRecords;
+
+    // output ETF file, compaction target
+    string etfFilePath, event, videoFileName;
+    double videoFPS;
+    FrameDedupMap *dedupMap;
+
+    mutex journalMutex;
+    condition_variable compactionCondition;
+    bool dirty, closed;
+    thread *compactionThread;
+};
+
+/** Period (in seconds) between two compactions of the label journal. */
+int LABEL_JOURNAL_COMPACTION_PERIOD = 30;
+
+/** Replays the label journal <journalFilePath> over the given store <frameLabels>.
+ *  Returns FALSE if there is no such journal; otherwise, returns TRUE and the last
+ *  position of the annotator in <frameNumber>. */
+bool replayLabelJournal(string journalFilePath, FrameLabelStore *frameLabels,
+                        int *frameNumber) {
+    ifstream journalReader(journalFilePath.data());
+    if (journalReader.fail())
+        return false;
+
+    string journalLine;
+    while (getline(journalReader, journalLine)) {
+        stringstream journalLineStream;
+        journalLineStream << journalLine;
+
+        char recordType = 0;
+        int firstFrameNumber, lastFrameNumber, label;
+        journalLineStream >> recordType;
+
+        if (recordType == 'L') {
+            journalLineStream >> firstFrameNumber >> lastFrameNumber >> label;
+            if (!journalLineStream.fail()) {
+                setFrameLabels(frameLabels, firstFrameNumber, lastFrameNumber, label);
+                *frameNumber = lastFrameNumber - 1;
+            }
+        } else if (recordType == 'P') {
+            journalLineStream >> firstFrameNumber;
+            if (!journalLineStream.fail())
+                *frameNumber = firstFrameNumber;
+        }
+        // else, a record cut by the crash: ignores it
+    }
+
+    journalReader.close();
+    return true;
+}
+
+/** Rewrites the journal of <labelJournal> with the label runs of <frameLabels>,
+ *  followed by the records still pending. Must be called with the journal mutex
+ *  locked. */
+void rewriteLabelJournal(LabelJournal *labelJournal, FrameLabelStore *frameLabels) {
+    string rewrittenFilePath = labelJournal->journalFilePath + ".tmp";
+    ofstream rewrittenWriter(rewrittenFilePath.data());
+
+    for (auto run = frameLabels->labelRuns.begin(); run != frameLabels->labelRuns.end(); run++)
+        rewrittenWriter << "L " << run->first << " " << getLabelRunEnd(frameLabels, run->first)
+                        << " " << run->second << "\n";
+    for (int i = 0; i < labelJournal->pendingRecords.size(); i++)
+        rewrittenWriter << labelJournal->pendingRecords.at(i) << "\n";
+    rewrittenWriter << "P " << labelJournal->lastFrameNumber << "\n";
+    rewrittenWriter.close();
+
+    if (rewrittenWriter.fail()
+        || rename(rewrittenFilePath.data(), labelJournal->journalFilePath.data()) != 0) {
+        cerr << "WARNING: Could not rewrite label journal "
+             << labelJournal->journalFilePath << "." << endl;
+        return;
+    }
+
+    labelJournal->journalWriter.close();
+    labelJournal->journalWriter.open(labelJournal->journalFilePath.data(), ios::app);
+    labelJournal->pendingRecords.clear();
+}
+
+/** Appends the given record <record> to the journal of <labelJournal>. Must be called
+ *  with the journal mutex locked. */
+void appendLabelJournalRecord(LabelJournal *labelJournal, string record) {
+    labelJournal->journalWriter << record << "\n";
+    labelJournal->journalWriter.flush();
+
+    labelJournal->pendingRecords.push_back(record);
+    labelJournal->dirty = true;
+}
+
+/** Compacts the journal of <labelJournal>: saves the current labels into the output
+ *  ETF file, and rewrites the journal with them. The labels are copied while the
+ *  journal is locked, and the ETF file is written without holding the lock. */
+void compactLabelJournal(LabelJournal *labelJournal) {
+    // snapshot of the labels
+    FrameLabelStore frameLabelsSnapshot;
+    {
+        lock_guard <mutex> journalLock(labelJournal->journalMutex);
+        frameLabelsSnapshot.frameCount = labelJournal->frameLabels->frameCount;
+        frameLabelsSnapshot.labelRuns = labelJournal->frameLabels->labelRuns;
+        labelJournal->pendingRecords.clear();
+        labelJournal->dirty = false;
+    }
+
+    // saves the ETF file, replacing the previous one only once it is complete
+    string temporaryETFFilePath = labelJournal->etfFilePath + ".tmp";
+    try {
+        generateAndSaveETFFile(temporaryETFFilePath, labelJournal->event,
+                               labelJournal->videoFPS, labelJournal->videoFileName,
+                               &frameLabelsSnapshot, labelJournal->dedupMap);
+    } catch (int e) {
+        return;
+    }
+    rename(temporaryETFFilePath.data(), labelJournal->etfFilePath.data());
+
+    // the journal restarts from the snapshot, plus what happened meanwhile
+    lock_guard <mutex> journalLock(labelJournal->journalMutex);
+    rewriteLabelJournal(labelJournal, &frameLabelsSnapshot);
+}
+
+/** Keeps on compacting the journal of <labelJournal>, every
+ *  LABEL_JOURNAL_COMPACTION_PERIOD seconds in which it changed, until it is closed. */
+void runLabelJournalCompaction(LabelJournal *labelJournal) {
+    unique_lock <mutex> journalLock(labelJournal->journalMutex);
+    while (!labelJournal->closed) {
+        labelJournal->compactionCondition.wait_for(
+                journalLock, chrono::seconds(LABEL_JOURNAL_COMPACTION_PERIOD));
+
+        if (labelJournal->dirty && !labelJournal->closed) {
+            journalLock.unlock();
+            compactLabelJournal(labelJournal);
+            journalLock.lock();
+        }
+    }
+}
+
+/** Opens the journal <journalFilePath> of the labels <frameLabels>, as <labelJournal>,
+ *  starting it with the current labels and position <frameNumber>, and starts its
+ *  background compaction into the ETF file <etfFilePath> (the other parameters are the
+ *  ones of generateAndSaveETFFile()). */
+void openLabelJournal(string journalFilePath, FrameLabelStore *frameLabels, int frameNumber,
+                      string etfFilePath, string event, double videoFPS,
+                      string videoFileName, FrameDedupMap *dedupMap,
+                      LabelJournal *labelJournal) {
+    labelJournal->journalFilePath = journalFilePath;
+    labelJournal->frameLabels = frameLabels;
+    labelJournal->lastFrameNumber = frameNumber;
+    labelJournal->etfFilePath = etfFilePath;
+    labelJournal->event = event;
+    labelJournal->videoFPS = videoFPS;
+    labelJournal->videoFileName = videoFileName;
+    labelJournal->dedupMap = dedupMap;
+    labelJournal->dirty = false;
+    labelJournal->closed = false;
+
+    {
+        lock_guard <mutex> journalLock(labelJournal->journalMutex);
+        rewriteLabelJournal(labelJournal, frameLabels);
+    }
+    if (!labelJournal->journalWriter.is_open()) {
+        cerr << "Could not write file " << journalFilePath << "." << endl;
+        throw -1;
+    }
+
+    labelJournal->compactionThread = new thread(runLabelJournalCompaction, labelJournal);
+}
+
+/** Gives the label <label> to the frames [<firstFrameNumber>, <lastFrameNumber>) of the
+ *  store of <labelJournal>, recording the change in the journal. */
+void recordFrameLabels(LabelJournal *labelJournal, int firstFrameNumber, int lastFrameNumber,
+                       int label) {
+    lock_guard <mutex> journalLock(labelJournal->journalMutex);
+    setFrameLabels(labelJournal->frameLabels, firstFrameNumber, lastFrameNumber, label);
+    labelJournal->lastFrameNumber = lastFrameNumber - 1;
+
+    stringstream record;
+    record << "L " << firstFrameNumber << " " << lastFrameNumber << " " << label;
+    appendLabelJournalRecord(labelJournal, record.str());
+}
+
+/** Records the current position <frameNumber> of the annotator in <labelJournal>. */
+void recordJournalPosition(LabelJournal *labelJournal, int frameNumber) {
+    lock_guard <mutex> journalLock(labelJournal->journalMutex);
+    if (labelJournal->lastFrameNumber == frameNumber)
+        return;
+    labelJournal->lastFrameNumber = frameNumber;
+
+    stringstream record;
+    record << "P " << frameNumber;
+    appendLabelJournalRecord(labelJournal, record.str());
+}
+
+/** Stops the compaction of <labelJournal> and closes it. The journal file is kept,
+ *  to be removed once the final ETF file is saved. */
+void closeLabelJournal(LabelJournal *labelJournal) {
+    {
+        lock_guard <mutex> journalLock(labelJournal->journalMutex);
+        labelJournal->closed = true;
+        labelJournal->compactionCondition.notify_all();
+    }
+    labelJournal->compactionThread->join();
+    delete labelJournal->compactionThread;
+
+    labelJournal->journalWriter.close();
+}
+
+/** Ring cache of the video frames being annotated, keyed by frame number: the frame
+ *  numbered n can only be held in the slot n % <capacity>, so any <capacity>
+ *  consecutive frames fit in the cache together, and a frame stays cached until
+ *  another frame of the same slot replaces it. */
+struct VideoFrameCache {
+    int capacity;
+    vector <Mat> frames;
+    vector<int> frameNumbers; // -1 for empty slots
+};
+
+/** Initializes the given cache <frameCache> with <capacity> empty slots. */
+void initVideoFrameCache(VideoFrameCache *frameCache, int capacity) {
+    frameCache->capacity = capacity;
+    frameCache->frames.assign(capacity, Mat());
+    frameCache->frameNumbers.assign(capacity, -1);
+}
+
+/** Returns TRUE if the frame numbered <frameNumber> is in the given cache <frameCache>,
+ *  putting it in <frame> (if not NULL), FALSE otherwise. */
+bool getCachedVideoFrame(VideoFrameCache *frameCache, int frameNumber, Mat *frame) {
+    int slot = frameNumber % frameCache->capacity;
+    if (frameCache->frameNumbers.at(slot) != frameNumber)
+        return false;
+
+    if (frame != NULL)
+        *frame = frameCache->frames.at(slot);
+    return true;
+}
+
+/** Puts the given frame <frame>, numbered <frameNumber>, in the given cache <frameCache>,
+ *  replacing the frame previously held in its slot. */
+void putCachedVideoFrame(VideoFrameCache *frameCache, int frameNumber, Mat frame) {
+    int slot = frameNumber % frameCache->capacity;
+    frameCache->frames.at(slot) = frame;
+    frameCache->frameNumbers.at(slot) = frameNumber;
+}
+
+/** Prefetcher of the video frames around the playhead. The threads of the shared frame
+ *  decoding pool fill the frame cache with the blocks (of VIDEO_FRAME_BUFFERS_SIZE
+ *  frames) around the frame being shown, each thread taking the most urgent frame not
+ *  being loaded by the others (up to <maxLoadingCount> frames at once). The threads
+ *  move on to other work once the frames are all cached, until the UI thread publishes
+ *  a new playhead or playback state. All the fields, and the cache, are protected by
+ *  <prefetchMutex>, except for <servingThreadCount>, protected by the mutex of the pool. */
+struct FramePrefetcher {
+    VideoFrameSource *frameSource;
+    VideoFrameCache frameCache;
+    int frameCount;
+    int playheadFrameNumber;
+    bool playReverse;
+    int videoShowingDelay;
+    bool stopped;
+    set<int> loadingFrameNumbers;
+    int maxLoadingCount;
+
+    // frames asked by the UI thread, and how many of them were already cached
+    int requestedFrameNumber;
+    int cacheHitCount, cacheMissCount;
+
+    // number of pool threads currently looking for frames to load for the prefetcher
+    int servingThreadCount;
+
+    mutex prefetchMutex;
+    condition_variable loadedCondition;
+};
+
+/** Pool of the threads decoding the frames to be shown, shared by the whole process. The
+ *  threads serve the registered prefetchers first (one per video being shown, since the
+ *  UI waits for them), then the submitted jobs (e.g., the loading of the first frames of
+ *  the next video to be annotated). They sleep while there is nothing to do, until a
+ *  prefetcher or a new job wakes them up; <wakeUpCount> tells a thread if it was woken
+ *  up while it was looking for work. All the fields are protected by <poolMutex>, which
+ *  may be locked while holding the mutex of a prefetcher, but never the other way
+ *  around. */
+struct FrameDecodingPool {
+    vector<FramePrefetcher *> prefetchers;
+    deque <std::function<void()>> jobs;
+    uint64_t wakeUpCount;
+    bool stopped;
+
+    mutex poolMutex;
+    condition_variable poolCondition, servedCondition;
+    vector<thread *> poolThreads;
+};
+
+/** Frame decoding pool of the process, started on its first use. */
+FrameDecodingPool FRAME_DECODING_POOL;
+
+/** Scale of the frames decoded for preview while annotating: they are shown with 1/x of
+ *  their size, with x being 1, 2, 4 or 8. The current frame can still be seen in full
+ *  size on demand. */
+int PREVIEW_SCALE = 1;
+
+/** Number of threads of the frame decoding pool (0 for as many as the hardware threads).
+ *  Frames read straight from a video file are decoded by one thread at a time, since
+ *  the video reader decodes forward sequentially. */
+int FRAME_DECODING_THREAD_COUNT = 0;
+
+/** Playback delay (in milliseconds per frame) below which, while playing, the frames
+ *  behind the playhead are not prefetched, so the decoding serves the frames ahead. */
+int PREFETCH_BEHIND_MIN_DELAY = 40;
+
+/** Time of playback (in milliseconds) that the frames prefetched ahead of the playhead
+ *  shall cover, so faster playback prefetches more blocks ahead. */
+int PREFETCH_AHEAD_TIME = 1000;
+
+/** Bounds of the number of blocks prefetched ahead of the playhead (the lower one while
+ *  stopped or slowly played, the upper one bounding the memory of the frame cache). */
+int PREFETCH_MIN_BLOCKS_AHEAD = 2;
+int PREFETCH_MAX_BLOCKS_AHEAD = 6;
+
+/** Returns the capacity of the frame cache of the prefetchers, enough for the block of
+ *  the playhead, the block behind it and the most blocks ahead of it. */
+int getFrameCacheCapacity() {
+    return (PREFETCH_MAX_BLOCKS_AHEAD + 2) * VIDEO_FRAME_BUFFERS_SIZE;
+}
+
+/** Lists in <blockNumbers> the numbers of the blocks of frames that the given prefetcher
+ *  <prefetcher> shall keep in cache, sorted by priority: the block of the playhead, the
+ *  blocks ahead of it (in the playing direction) covering PREFETCH_AHEAD_TIME of playback
+ *  at the current speed, and, if the video is stopped or slowly played, the block behind
+ *  it. Must be called with the prefetcher locked. */
+void getPrefetchBlockNumbers(FramePrefetcher *prefetcher, vector<int> *blockNumbers) {
+    int playheadBlockNumber = prefetcher->playheadFrameNumber / VIDEO_FRAME_BUFFERS_SIZE;
+    int lastBlockNumber = (prefetcher->frameCount - 1) / VIDEO_FRAME_BUFFERS_SIZE;
+    int step = (prefetcher->playReverse ? -1 : 1);
+    bool behindWanted = prefetcher->videoShowingDelay == 0
+                        || prefetcher->videoShowingDelay >= PREFETCH_BEHIND_MIN_DELAY;
+
+    // blocks ahead enough for the frames shown within PREFETCH_AHEAD_TIME
+    int aheadBlockCount = PREFETCH_MIN_BLOCKS_AHEAD;
+    if (prefetcher->videoShowingDelay > 0) {
+        int aheadFrameCount = PREFETCH_AHEAD_TIME / prefetcher->videoShowingDelay;
+        aheadBlockCount = (aheadFrameCount + VIDEO_FRAME_BUFFERS_SIZE - 1)
+                          / VIDEO_FRAME_BUFFERS_SIZE;
+        aheadBlockCount = min(max(aheadBlockCount, PREFETCH_MIN_BLOCKS_AHEAD),
+                              PREFETCH_MAX_BLOCKS_AHEAD);
+    }
+
+    vector<int> candidateBlockNumbers;
+    for (int i = 0; i <= aheadBlockCount; i++)
+        candidateBlockNumbers.push_back(playheadBlockNumber + i * step);
+    if (behindWanted)
+        candidateBlockNumbers.push_back(playheadBlockNumber - step);
+
+    blockNumbers->clear();
+    for (int blockNumber : candidateBlockNumbers)
+        if (blockNumber >= 0 && blockNumber <= lastBlockNumber)
+            blockNumbers->push_back(blockNumber);
+}
+
+/** Returns the number of the next frame that the given prefetcher <prefetcher> shall
+ *  load, or -1 if all the wanted frames are already cached or being loaded. Inside the
+ *  block of the playhead, the frames from the playhead on come first. Must be called
+ *  with the prefetcher locked. */
+int getNextFrameToPrefetch(FramePrefetcher *prefetcher) {
+    vector<int> blockNumbers;
+    getPrefetchBlockNumbers(prefetcher, &blockNumbers);
+
+    for (int blockNumber : blockNumbers) {
+        int firstFrameNumber = blockNumber * VIDEO_FRAME_BUFFERS_SIZE;
+        int lastFrameNumber = min(firstFrameNumber + VIDEO_FRAME_BUFFERS_SIZE,
+                                  prefetcher->frameCount);
+
+        int fromFrameNumber = firstFrameNumber;
+        if (prefetcher->playheadFrameNumber >= firstFrameNumber
+            && prefetcher->playheadFrameNumber < lastFrameNumber)
+            fromFrameNumber = prefetcher->playheadFrameNumber;
+
+        for (int i = 0; i < lastFrameNumber - firstFrameNumber; i++) {
+            int frameNumber = fromFrameNumber + i;
+            if (frameNumber >= lastFrameNumber)
+                frameNumber = frameNumber - (lastFrameNumber - firstFrameNumber);
+
+            if (!getCachedVideoFrame(&prefetcher->frameCache, frameNumber, NULL)
+                && prefetcher->loadingFrameNumbers.count(frameNumber) == 0)
+                return frameNumber;
+        }
+    }
+
+    return -1;
+}
+
+/** Returns TRUE if the frame numbered <frameNumber> is still wanted by the given
+ *  prefetcher <prefetcher>, FALSE otherwise. Must be called with the prefetcher locked. */
+bool isFrameToPrefetch(FramePrefetcher *prefetcher, int frameNumber) {
+    vector<int> blockNumbers;
+    getPrefetchBlockNumbers(prefetcher, &blockNumbers);
+
+    return find(blockNumbers.begin(), blockNumbers.end(),
+                frameNumber / VIDEO_FRAME_BUFFERS_SIZE) != blockNumbers.end();
+}
+
+/** Loads, into the cache of the given prefetcher <prefetcher>, the next frame that it
+ *  wants. Returns FALSE if there is none (the wanted frames are all cached or being
+ *  loaded, or the prefetcher is already loading as many frames as it can). Run by the
+ *  threads of the frame decoding pool. The frame is loaded without holding the lock,
+ *  and discarded if the playhead moved too far away meanwhile. */
+bool prefetchNextFrame(FramePrefetcher *prefetcher) {
+    unique_lock <mutex> prefetchLock(prefetcher->prefetchMutex);
+    if (prefetcher->stopped || prefetcher->loadingFrameNumbers.size() >= prefetcher->maxLoadingCount)
+        return false;
+
+    int frameNumber = getNextFrameToPrefetch(prefetcher);
+    if (frameNumber < 0)
+        return false;
+
+    // loads the frame, letting the UI and the other threads go on meanwhile
+    prefetcher->loadingFrameNumbers.insert(frameNumber);
+    prefetchLock.unlock();
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    Mat frame = readVideoFrame(prefetcher->frameSource, frameNumber, PREVIEW_SCALE);
+    recordStageTime(STAGE_FRAME_READ, beginTime);
+    prefetchLock.lock();
+    prefetcher->loadingFrameNumbers.erase(frameNumber);
+
+    // the frame slot is given by its number, whatever the order the frames arrive
+    if (isFrameToPrefetch(prefetcher, frameNumber)) {
+        putCachedVideoFrame(&prefetcher->frameCache, frameNumber, frame);
+        prefetcher->loadedCondition.notify_all();
+    }
+    return true;
+}
+
+/** Keeps on serving the prefetchers and the jobs of the given frame decoding pool
+ *  <pool>, until it is stopped. Run by each one of the threads of the pool. */
+void runFrameDecodingPool(FrameDecodingPool *pool) {
+    unique_lock <mutex> poolLock(pool->poolMutex);
+
+    while (!pool->stopped) {
+        uint64_t wakeUpCount = pool->wakeUpCount;
+
+        // serves the prefetchers first, without holding the lock
+        vector<FramePrefetcher *> prefetchers = pool->prefetchers;
+        for (FramePrefetcher *prefetcher : prefetchers)
+            prefetcher->servingThreadCount++;
+        poolLock.unlock();
+
+        bool frameLoaded = false;
+        for (FramePrefetcher *prefetcher : prefetchers)
+            if (prefetchNextFrame(prefetcher))
+                frameLoaded = true;
+
+        poolLock.lock();
+        for (FramePrefetcher *prefetcher : prefetchers)
+            prefetcher->servingThreadCount--;
+        if (!prefetchers.empty())
+            pool->servedCondition.notify_all();
+        if (frameLoaded)
+            continue;
+
+        // then the jobs
+        if (!pool->jobs.empty()) {
+            std::function<void()> job = pool->jobs.front();
+            pool->jobs.pop_front();
+            poolLock.unlock();
+            job();
+            poolLock.lock();
+            continue;
+        }
+
+        // nothing to do: sleeps, unless something new came up meanwhile
+        pool->poolCondition.wait(poolLock, [pool, wakeUpCount] {
+            return pool->stopped || pool->wakeUpCount != wakeUpCount;
+        });
+    }
 }
 
-/** Reads a list with absolute paths to videos, from a given text file. */
-void readVideoFilePathList(string inputFilePath, vector <string> *answer) {
-    // input text file reader
-    ifstream fileReader;
-    fileReader.open(inputFilePath.data());
-    if (fileReader.fail()) {
-        cerr << "Could not open file " << inputFilePath << "." << endl;
-        throw -1;
+/** Starts the threads of the given frame decoding pool <pool>, if they are not running
+ *  yet. Must be called with the pool locked. */
+void startFrameDecodingPool(FrameDecodingPool *pool) {
+    if (!pool->poolThreads.empty())
+        return;
+
+    int poolThreadCount = FRAME_DECODING_THREAD_COUNT;
+    if (poolThreadCount <= 0)
+        poolThreadCount = thread::hardware_concurrency();
+    if (poolThreadCount <= 0)
+        poolThreadCount = 1;
+
+    pool->stopped = false;
+    pool->wakeUpCount = 0;
+    for (int i = 0; i < poolThreadCount; i++)
+        pool->poolThreads.push_back(new thread(runFrameDecodingPool, pool));
+}
+
+/** Stops the threads of the given frame decoding pool <pool>, waiting for them to finish
+ *  their current work. The pool starts again on its next use. */
+void stopFrameDecodingPool(FrameDecodingPool *pool) {
+    {
+        lock_guard <mutex> poolLock(pool->poolMutex);
+        pool->stopped = true;
+        pool->poolCondition.notify_all();
+    }
+    for (thread *poolThread : pool->poolThreads) {
+        poolThread->join();
+        delete poolThread;
     }
+    pool->poolThreads.clear();
+}
 
-    // holds the current line read from the input file
-    string line;
+/** Wakes up the threads of the given frame decoding pool <pool>, since some prefetcher
+ *  may want new frames. */
+void wakeUpFrameDecodingPool(FrameDecodingPool *pool) {
+    lock_guard <mutex> poolLock(pool->poolMutex);
+    pool->wakeUpCount++;
+    pool->poolCondition.notify_all();
+}
 
-    // while there are paths to be read, adds them to the answer
-    while (getline(fileReader, line))
-        answer->push_back(line);
+/** Runs <jobCount> jobs on the given frame decoding pool <pool>, calling <job> with each
+ *  job number (from 0 to <jobCount> - 1), and waits for them all to finish. If any job
+ *  throws, the first thrown exception is thrown again once they are all finished. */
+void runFrameDecodingJobs(FrameDecodingPool *pool, int jobCount, std::function<void(int)> job) {
+    mutex jobsMutex;
+    condition_variable jobsCondition;
+    int finishedJobCount = 0;
+    exception_ptr jobError;
 
-    // closes the input file
-    fileReader.close();
-}
+    {
+        lock_guard <mutex> poolLock(pool->poolMutex);
+        startFrameDecodingPool(pool);
+        for (int i = 0; i < jobCount; i++)
+            pool->jobs.push_back([&, i] {
+                exception_ptr error;
+                try {
+                    job(i);
+                } catch (...) {
+                    error = current_exception();
+                }
 
-/** Determines new width and height values for the frames extracted from a given video file,
- *  of which original dimensions are given as parameters, assuming that the user decided for
- *  a new number of pixels per frame, and that the original video aspect ratio must be
- *  maintained. If the desired new number of pixels per frame is greater than the original
- *  one, this function does nothing (i.e. it simply returns the original video width and
- *  height. */
-void calculateNewWidthAndHeight(int originalWidth, int originalHeight,
-                                int desiredPixelCount, int *newWidth, int *newHeight) {
-    int originalPixelCount = originalWidth * originalHeight;
+                lock_guard <mutex> jobsLock(jobsMutex);
+                if (error && !jobError)
+                    jobError = error;
+                finishedJobCount++;
+                jobsCondition.notify_all();
+            });
+        pool->wakeUpCount++;
+        pool->poolCondition.notify_all();
+    }
 
-    // calculates the new width and height
-    if (desiredPixelCount < originalPixelCount) {
-        double videoAspectRatio = originalWidth * pow(originalHeight, -1);
+    unique_lock <mutex> jobsLock(jobsMutex);
+    jobsCondition.wait(jobsLock, [&] { return finishedJobCount == jobCount; });
+    if (jobError)
+        rethrow_exception(jobError);
+}
 
-        *newHeight = round(sqrt(desiredPixelCount / videoAspectRatio));
-        *newWidth = round(videoAspectRatio * *newHeight);
+/** Starts the given prefetcher <prefetcher>, to feed its cache with the frames of
+ *  <frameSource> around the playhead <playheadFrameNumber>, registering it in the frame
+ *  decoding pool. The cache begins with the frames of <preloadedFrames>, if not NULL. */
+void startFramePrefetcher(FramePrefetcher *prefetcher, VideoFrameSource *frameSource,
+                          int playheadFrameNumber, VideoFrameCache *preloadedFrames) {
+    initVideoFrameCache(&prefetcher->frameCache, getFrameCacheCapacity());
+    if (preloadedFrames != NULL)
+        for (int i = 0; i < preloadedFrames->capacity; i++)
+            if (preloadedFrames->frameNumbers.at(i) >= 0)
+                putCachedVideoFrame(&prefetcher->frameCache, preloadedFrames->frameNumbers.at(i),
+                                    preloadedFrames->frames.at(i));
+    prefetcher->frameSource = frameSource;
+    prefetcher->frameCount = frameSource->frameCount;
+    prefetcher->playheadFrameNumber = playheadFrameNumber;
+    prefetcher->playReverse = false;
+    prefetcher->videoShowingDelay = 0;
+    prefetcher->stopped = false;
+    prefetcher->loadingFrameNumbers.clear();
+    prefetcher->maxLoadingCount = (frameSource->videoReader != NULL ? 1 : INT_MAX);
+    prefetcher->requestedFrameNumber = -1;
+    prefetcher->cacheHitCount = 0;
+    prefetcher->cacheMissCount = 0;
+    prefetcher->servingThreadCount = 0;
+
+    FrameDecodingPool *pool = &FRAME_DECODING_POOL;
+    lock_guard <mutex> poolLock(pool->poolMutex);
+    startFrameDecodingPool(pool);
+    pool->prefetchers.push_back(prefetcher);
+    pool->wakeUpCount++;
+    pool->poolCondition.notify_all();
+}
+
+/** Stops the given prefetcher <prefetcher>, unregistering it from the frame decoding
+ *  pool and waiting for the pool threads to be done with it. */
+void stopFramePrefetcher(FramePrefetcher *prefetcher) {
+    {
+        lock_guard <mutex> prefetchLock(prefetcher->prefetchMutex);
+        prefetcher->stopped = true;
     }
-        // does not change video resolution, if the desired pixel count is greater than
-        // the current one
-    else {
-        *newHeight = originalHeight;
-        *newWidth = originalWidth;
+
+    FrameDecodingPool *pool = &FRAME_DECODING_POOL;
+    unique_lock <mutex> poolLock(pool->poolMutex);
+    pool->prefetchers.erase(remove(pool->prefetchers.begin(), pool->prefetchers.end(),
+                                   prefetcher), pool->prefetchers.end());
+    pool->servedCondition.wait(poolLock, [prefetcher] {
+        return prefetcher->servingThreadCount == 0;
+    });
+}
+
+/** Publishes the playback state (<playheadFrameNumber>, <playReverse> and
+ *  <videoShowingDelay>) to the given prefetcher <prefetcher>, waking it up if the
+ *  state changed. */
+void publishPlaybackState(FramePrefetcher *prefetcher, int playheadFrameNumber,
+                          bool playReverse, int videoShowingDelay) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    lock_guard <mutex> prefetchLock(prefetcher->prefetchMutex);
+    recordStageTime(STAGE_LOCK_WAIT, beginTime);
+    if (prefetcher->playheadFrameNumber != playheadFrameNumber
+        || prefetcher->playReverse != playReverse
+        || prefetcher->videoShowingDelay != videoShowingDelay) {
+        prefetcher->playheadFrameNumber = playheadFrameNumber;
+        prefetcher->playReverse = playReverse;
+        prefetcher->videoShowingDelay = videoShowingDelay;
+        wakeUpFrameDecodingPool(&FRAME_DECODING_POOL);
     }
 }
 
-/** Extracts all the frames from a given video, and saves them in the given directory.
- *  It is recommended for the video to be in H.264 MPEG-4 format. The frames are output as
- *  JPG images, named with the video file name + frame number + a sequence number (from
- *  00000001 to N). The size of the saved frames can be informed as a new desired total
- *  number of pixels per frame, or 0 if the original size shall be maintained. If the new
- *  desired total number of pixels is greater than the original one, the sizes of the frames
- *  are simply maintained. */
-void extractAndSaveVideoFrames(string videoFilePath, string frameDirPath,
-                               int totalPixelCount) {
-    // tries to open the given dir path to store the extracted i-frames
-    DIR *pDir;
-    pDir = opendir(frameDirPath.data());
-    if (pDir == NULL)
-        // tries to create the directory
-        mkdir(videoFilePath.data(), 0777);
+/** Returns TRUE if the frame numbered <frameNumber> is already cached by the given
+ *  prefetcher <prefetcher>, FALSE otherwise. */
+bool isVideoFrameCached(FramePrefetcher *prefetcher, int frameNumber) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    lock_guard <mutex> prefetchLock(prefetcher->prefetchMutex);
+    recordStageTime(STAGE_LOCK_WAIT, beginTime);
+    return getCachedVideoFrame(&prefetcher->frameCache, frameNumber, NULL);
+}
 
-    pDir = opendir(frameDirPath.data());
-    if (pDir == NULL) {
-        cerr << "Could not open neither create directory " << frameDirPath
-             << "." << endl;
-        throw -1;
+/** Maximum time (in milliseconds) the UI waits for a frame that is not cached yet
+ *  (e.g., right after a jump), before going on treating the keyboard while the frame
+ *  is loaded in background. */
+int FRAME_LOADING_WAIT_TIME = 50;
+
+/** Puts in <frame> the frame numbered <frameNumber>, waiting at most <waitTime>
+ *  milliseconds (or indefinitely, if negative) for the given prefetcher <prefetcher>
+ *  to load it, if it is not cached yet. The frame becomes the playhead of the
+ *  prefetcher, so it is the next one to be loaded. Returns TRUE if the frame could be
+ *  obtained, FALSE otherwise. */
+bool waitForVideoFrame(FramePrefetcher *prefetcher, int frameNumber, int waitTime,
+                       Mat *frame) {
+    chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+    unique_lock <mutex> prefetchLock(prefetcher->prefetchMutex);
+    recordStageTime(STAGE_LOCK_WAIT, beginTime);
+
+    // the frame to be shown comes first
+    if (prefetcher->playheadFrameNumber != frameNumber) {
+        prefetcher->playheadFrameNumber = frameNumber;
+        wakeUpFrameDecodingPool(&FRAME_DECODING_POOL);
     }
-    closedir(pDir);
 
-    // obtains the name of the original video file
-    vector <string> *videoFilePathTokens = new vector<string>;
-    split(*videoFilePathTokens, videoFilePath, is_any_of("/"));
-    string videoFileName = videoFilePathTokens->back();
-    videoFilePathTokens->clear();
-    delete videoFilePathTokens;
+    auto frameLoaded = [prefetcher, frameNumber, frame] {
+        return getCachedVideoFrame(&prefetcher->frameCache, frameNumber, frame);
+    };
+
+    // counts if a newly asked frame is served by the cache
+    if (prefetcher->requestedFrameNumber != frameNumber) {
+        prefetcher->requestedFrameNumber = frameNumber;
+        if (getCachedVideoFrame(&prefetcher->frameCache, frameNumber, NULL))
+            prefetcher->cacheHitCount++;
+        else
+            prefetcher->cacheMissCount++;
+    }
 
-    // video reader
-    VideoCapture *videoReader = new VideoCapture(videoFilePath);
+    beginTime = chrono::steady_clock::now();
+    bool loaded = true;
+    if (waitTime < 0)
+        prefetcher->loadedCondition.wait(prefetchLock, frameLoaded);
+    else
+        loaded = prefetcher->loadedCondition.wait_for(prefetchLock,
+                                                      chrono::milliseconds(waitTime),
+                                                      frameLoaded);
+    recordStageTime(STAGE_FRAME_WAIT, beginTime);
+    return loaded;
+}
 
-    // determines new frame width and frame height values, if it is the case
-    int frameWidth = 0, frameHeight = 0;
-    if (totalPixelCount > 0) {
-        Mat firstFrame;
-        videoReader->read(firstFrame);
+/** Number of thumbnails of the timeline strip shown below the frames, evenly sampled
+ *  along the video. */
+int TIMELINE_THUMBNAIL_COUNT = 100;
+
+/** Size of the thumbnails of the timeline strip, as they are cached on disk. */
+const int TIMELINE_THUMBNAIL_WIDTH = 64;
+const int TIMELINE_THUMBNAIL_HEIGHT = 36;
+
+/** Height of the bar with the frame labels, drawn below the thumbnails. */
+const int TIMELINE_LABEL_BAR_HEIGHT = 8;
+
+/** Timeline strip shown below the frames, made of tiny thumbnails of the video (generated
+ *  once in background, and cached on disk, side by side in a single image) and of a bar
+ *  with the frame labels. Clicking or dragging over the strip seeks the video.
+ *
+ *  The thumbnails are protected by <thumbnailMutex>; the other fields belong to the UI
+ *  thread, which also runs the mouse callback. */
+struct TimelineStrip {
+    string thumbnailFilePath, fallbackThumbnailFilePath;
+    int frameCount;
+
+    Mat thumbnails;
+    int readyThumbnailCount;
+    mutex thumbnailMutex;
+    thread *thumbnailThread;
+    atomic<bool> stopped;
+
+    // strip rendered with the width of the shown frames
+    Mat renderedStrip;
+    int renderedThumbnailCount;
+
+    // position of the strip in the window, and frame wanted by the mouse (-1 if none)
+    int top, width;
+    int seekFrameNumber;
+};
+
+/** Returns the path of the file caching the timeline thumbnails of the given input
+ *  file <inputFilePath> (either a frame list, a frame archive, or a video file). */
+string getTimelineThumbnailFilePath(string inputFilePath) {
+    return inputFilePath + ".thumbs.jpg";
+}
 
-        int originalFrameWidth, originalFrameHeight;
-        originalFrameWidth = firstFrame.cols;
-        originalFrameHeight = firstFrame.rows;
+/** Returns the path of the file caching, in the given directory <dirPath>, the timeline
+ *  thumbnails of the video of file name <videoFileName>, for when they cannot be cached
+ *  next to the input file (e.g., a read-only one). */
+string getFallbackTimelineThumbnailFilePath(string dirPath, string videoFileName) {
+    return dirPath + "/" + videoFileName + ".thumbs.jpg";
+}
 
-        calculateNewWidthAndHeight(originalFrameWidth, originalFrameHeight,
-                                   totalPixelCount, &frameWidth, &frameHeight);
+/** Reads the timeline thumbnails cached at <thumbnailFilePath> into <thumbnails>, if the
+ *  file is not older than the input file <inputFilePath> and holds all the thumbnails.
+ *  Returns FALSE otherwise. */
+bool readTimelineThumbnails(string thumbnailFilePath, string inputFilePath, Mat *thumbnails) {
+    struct stat inputStat, thumbnailStat;
+    if (stat(inputFilePath.data(), &inputStat) != 0
+        || stat(thumbnailFilePath.data(), &thumbnailStat) != 0
+        || thumbnailStat.st_mtime < inputStat.st_mtime)
+        return false;
+
+    *thumbnails = imread(thumbnailFilePath);
+    return thumbnails->cols == TIMELINE_THUMBNAIL_COUNT * TIMELINE_THUMBNAIL_WIDTH
+           && thumbnails->rows == TIMELINE_THUMBNAIL_HEIGHT;
+}
 
-        videoReader->release();
-        videoReader = new VideoCapture(videoFilePath);
+/** Caches the given timeline thumbnails <thumbnails> at <thumbnailFilePath>. Returns
+ *  FALSE if the file could not be written. */
+bool saveTimelineThumbnails(string thumbnailFilePath, Mat thumbnails) {
+    try {
+        return imwrite(thumbnailFilePath, thumbnails);
+    } catch (cv::Exception &e) {
+        return false;
     }
+}
 
-    // extracts the frames
-    int frameCount = -1;
-    Mat currentFrame;
-    while (videoReader->read(currentFrame)) {
-        // one more frame obtained
-        frameCount++;
+/** Returns the number of the frame represented by the thumbnail <thumbnailNumber>
+ *  of the given timeline strip <timelineStrip>. */
+int getTimelineFrameNumber(TimelineStrip *timelineStrip, int thumbnailNumber) {
+    return int((2 * int64_t(thumbnailNumber) + 1) * timelineStrip->frameCount
+               / (2 * TIMELINE_THUMBNAIL_COUNT));
+}
 
-        // if the frame is to be resized, does it
-        if (frameWidth > 0 && frameHeight > 0)
-            resize(currentFrame, currentFrame, Size(frameWidth, frameHeight),
-                   INTER_CUBIC);
+/** Generates the thumbnails of the given timeline strip <timelineStrip> from the given
+ *  frame source <frameSource>, and caches them on disk. The frames of video files are
+ *  read by a separate reader, only at key frames, so the frames being shown are not
+ *  delayed by the seeks. */
+void generateTimelineThumbnails(TimelineStrip *timelineStrip, VideoFrameSource *frameSource) {
+    VideoCapture videoReader;
+    if (frameSource->videoReader != NULL)
+        videoReader.open(frameSource->videoFilePath);
+
+    for (int i = 0; i < TIMELINE_THUMBNAIL_COUNT && !timelineStrip->stopped; i++) {
+        int frameNumber = getTimelineFrameNumber(timelineStrip, i);
+
+        Mat frame;
+        if (frameSource->videoReader != NULL) {
+            // closest key frame at or before the wanted frame
+            vector<int> *keyFrameNumbers = &frameSource->videoIndex.keyFrameNumbers;
+            auto keyFrame = upper_bound(keyFrameNumbers->begin(), keyFrameNumbers->end(),
+                                        frameNumber);
+            videoReader.set(CAP_PROP_POS_FRAMES,
+                            (keyFrame == keyFrameNumbers->begin() ? 0 : *(keyFrame - 1)));
+            videoReader.read(frame);
+        } else
+            frame = readVideoFrame(frameSource, frameNumber, 8);
+
+        Mat thumbnail = Mat::zeros(TIMELINE_THUMBNAIL_HEIGHT, TIMELINE_THUMBNAIL_WIDTH,
+                                   CV_8UC3);
+        if (!frame.empty())
+            resize(frame, thumbnail, thumbnail.size(), 0, 0, INTER_AREA);
+
+        lock_guard <mutex> thumbnailLock(timelineStrip->thumbnailMutex);
+        Mat thumbnailSlot = timelineStrip->thumbnails.colRange(
+                i * TIMELINE_THUMBNAIL_WIDTH, (i + 1) * TIMELINE_THUMBNAIL_WIDTH);
+        thumbnail.copyTo(thumbnailSlot);
+        timelineStrip->readyThumbnailCount = i + 1;
+    }
 
-        // mounts the name of the file of the current frame
-        // completes the number of the frame with zeros
-        char frameNumberChars[8];
-        sprintf(frameNumberChars, "%.7d", frameCount);
+    videoReader.release();
 
-        // mounts the name of the current file
-        stringstream frameFilePathStream;
-        frameFilePathStream << frameDirPath << "/" << videoFileName << "-"
-                            << frameNumberChars << ".jpg";
+    // caches the thumbnails next to the input file, or else in the fallback directory
+    if (!timelineStrip->stopped
+        && !saveTimelineThumbnails(timelineStrip->thumbnailFilePath, timelineStrip->thumbnails)
+        && !saveTimelineThumbnails(timelineStrip->fallbackThumbnailFilePath,
+                                   timelineStrip->thumbnails))
+        cerr << "Could not cache the timeline thumbnails at " << timelineStrip->thumbnailFilePath
+             << " nor at " << timelineStrip->fallbackThumbnailFilePath << "." << endl;
+}
 
-        // saves the frame
-        imwrite(frameFilePathStream.str(), currentFrame);
+/** Starts the given timeline strip <timelineStrip> of the given frame source
+ *  <frameSource>, which was opened from <inputFilePath>. The thumbnails are read from
+ *  their cache file, if it is newer than the input file; otherwise, they are generated
+ *  in background. The cache file is kept next to the input file or, if it cannot be
+ *  written there, in the given directory <fallbackDirPath>. */
+void startTimelineStrip(TimelineStrip *timelineStrip, VideoFrameSource *frameSource,
+                        string inputFilePath, string fallbackDirPath) {
+    timelineStrip->thumbnailFilePath = getTimelineThumbnailFilePath(inputFilePath);
+    timelineStrip->fallbackThumbnailFilePath = getFallbackTimelineThumbnailFilePath(
+            fallbackDirPath, frameSource->videoFileName);
+    timelineStrip->frameCount = frameSource->frameCount;
+    timelineStrip->readyThumbnailCount = 0;
+    timelineStrip->thumbnailThread = NULL;
+    timelineStrip->stopped = false;
+    timelineStrip->renderedThumbnailCount = -1;
+    timelineStrip->top = -1;
+    timelineStrip->width = 0;
+    timelineStrip->seekFrameNumber = -1;
+
+    // tries to read the cached thumbnails
+    if (readTimelineThumbnails(timelineStrip->thumbnailFilePath, inputFilePath,
+                               &timelineStrip->thumbnails)
+        || readTimelineThumbnails(timelineStrip->fallbackThumbnailFilePath, inputFilePath,
+                                  &timelineStrip->thumbnails)) {
+        timelineStrip->readyThumbnailCount = TIMELINE_THUMBNAIL_COUNT;
+        return;
     }
 
-    // frees memory
-    videoReader->release();
-    delete videoReader;
+    // generates the thumbnails in background
+    timelineStrip->thumbnails = Mat::zeros(TIMELINE_THUMBNAIL_HEIGHT,
+                                           TIMELINE_THUMBNAIL_COUNT * TIMELINE_THUMBNAIL_WIDTH,
+                                           CV_8UC3);
+    timelineStrip->thumbnailThread = new thread(generateTimelineThumbnails, timelineStrip,
+                                                frameSource);
 }
 
-/** Reads a given input file and obtains a list with the file paths of the frames
- *  previously extracted from a video to be annotated. */
-void readFrameFilePaths(string inputFilePath, vector <string> *frameFilePaths) {
-    ifstream fileReader;
-    fileReader.open(inputFilePath.data());
-    if (fileReader.fail()) {
-        cerr << "Could not open file " << inputFilePath << "." << endl;
-        throw -1;
+/** Stops the given timeline strip <timelineStrip>, waiting for the generation of its
+ *  thumbnails to finish, if it is still running. */
+void stopTimelineStrip(TimelineStrip *timelineStrip) {
+    timelineStrip->stopped = true;
+    if (timelineStrip->thumbnailThread != NULL) {
+        timelineStrip->thumbnailThread->join();
+        delete timelineStrip->thumbnailThread;
+        timelineStrip->thumbnailThread = NULL;
     }
+}
 
-    string line;
-    while (getline(fileReader, line))
-        frameFilePaths->push_back(line);
+/** Renders the thumbnails of the given timeline strip <timelineStrip> with the given
+ *  width <width>, if they were not rendered yet with such width, or if more thumbnails
+ *  got ready since then. */
+void renderTimelineStrip(TimelineStrip *timelineStrip, int width) {
+    lock_guard <mutex> thumbnailLock(timelineStrip->thumbnailMutex);
+    if (timelineStrip->renderedStrip.cols == width
+        && timelineStrip->renderedThumbnailCount == timelineStrip->readyThumbnailCount)
+        return;
+
+    timelineStrip->renderedStrip = Mat::zeros(
+            TIMELINE_THUMBNAIL_HEIGHT + TIMELINE_LABEL_BAR_HEIGHT, width, CV_8UC3);
+
+    for (int i = 0; i < timelineStrip->readyThumbnailCount; i++) {
+        int left = i * width / TIMELINE_THUMBNAIL_COUNT;
+        int right = (i + 1) * width / TIMELINE_THUMBNAIL_COUNT;
+        if (right <= left)
+            continue;
+
+        Mat thumbnail = timelineStrip->thumbnails.colRange(
+                i * TIMELINE_THUMBNAIL_WIDTH, (i + 1) * TIMELINE_THUMBNAIL_WIDTH);
+        Mat thumbnailSlot = timelineStrip->renderedStrip(
+                Rect(left, 0, right - left, TIMELINE_THUMBNAIL_HEIGHT));
+        resize(thumbnail, thumbnailSlot, thumbnailSlot.size(), 0, 0, INTER_AREA);
+    }
 
-    fileReader.close();
+    timelineStrip->renderedThumbnailCount = timelineStrip->readyThumbnailCount;
 }
 
-/** Reads the content of a given ETF file, regarding the annotation of a video
- *  of interest, of which file name is given as a parameter.
- *
- *  The frame rate of the video must also be informed, in terms of FPS.
- *
- *  Parameter <positiveFrames> outputs the number of the frames marked as
- *  positive in the ETF file.
- *  Parameter <negativeFrames>, on its turn, outputs the number of the frames
- *  marked as negative.
- *
- *  ETF file: format created within the MediaEval (https://multimediaeval.github.io/)
- *  violent scenes localization task. */
-void readInputETFFile(string videoFileName, double videoFPS, string etfFilePath,
-                      set<int> *positiveFrames, set<int> *negativeFrames) {
-    // opens the ETF file
-    ifstream etfReader;
-    etfReader.open(etfFilePath.data());
-    if (etfReader.fail()) {
-        cerr << "Could not open file " << etfFilePath << "." << endl;
-        throw -1;
+/** Draws, on the given composed timeline <timeline>, the bar with the labels of the frames
+ *  <frameLabels> (red for positive, green for negative), and the position of the frame
+ *  numbered <frameNumber>. */
+void drawTimelineStatus(Mat *timeline, TimelineStrip *timelineStrip,
+                        FrameLabelStore *frameLabels, int frameNumber) {
+    int frameCount = timelineStrip->frameCount;
+    if (frameCount <= 0)
+        return;
+
+    // one rectangle per label run
+    for (int runBegin = 0; runBegin < frameCount;) {
+        int runEnd = getLabelRunEnd(frameLabels, runBegin);
+        int label = getFrameLabel(frameLabels, runBegin);
+
+        Scalar color(0, 0, 0);
+        if (label == POSITIVE_LABEL)
+            color = Scalar(0, 0, 200);
+        else if (label == NEGATIVE_LABEL)
+            color = Scalar(0, 200, 0);
+
+        rectangle(*timeline,
+                  Point(int(int64_t(runBegin) * timeline->cols / frameCount),
+                        TIMELINE_THUMBNAIL_HEIGHT),
+                  Point(int(int64_t(runEnd) * timeline->cols / frameCount),
+                        timeline->rows - 1), color, -1);
+        runBegin = runEnd;
     }
 
-    // keeps on reading the ETF file,
-    // until it reaches the lines related to the wanted video file
-    string etfLine;
-    while (getline(etfReader, etfLine))
-        if (etfLine[0] != '#' && etfLine.find(videoFileName) != string::npos) {
-            // parses the current line
-            stringstream etfLineStream;
-            etfLineStream << etfLine;
-
-            // obtained data
-            string generalToken, label;
-            double beginTime, duration;
-            etfLineStream >> generalToken >> generalToken >> beginTime
-                          >> duration >> generalToken >> generalToken >> generalToken
-                          >> generalToken >> label;
-            if (etfLineStream.fail()) {
-                cerr << "File " << etfFilePath << " is not a valid ETF one."
-                     << endl;
-                throw -2;
-            }
+    int x = int(int64_t(frameNumber) * timeline->cols / frameCount);
+    line(*timeline, Point(x, TIMELINE_THUMBNAIL_HEIGHT), Point(x, timeline->rows - 1),
+         Scalar(255, 255, 255), 2);
+}
 
-            // fulfills the numbers of positive or negative frames
-            double firstFrameNumber = beginTime * videoFPS;
-            double lastFrameNumber = firstFrameNumber + duration * videoFPS;
+/** Period (in milliseconds) in which the keyboard is polled while the video is stopped,
+ *  so that clicks on the timeline strip and newly generated thumbnails are shown. */
+int TIMELINE_POLLING_DELAY = 30;
+
+/** Waits for a pressed key for <videoShowingDelay> milliseconds or, if it is ZERO, until
+ *  either a key is pressed, the timeline strip <timelineStrip> is clicked, or new
+ *  thumbnails of it get ready. Returns the pressed key, or -1 if none. */
+int waitKeyOrTimelineChange(TimelineStrip *timelineStrip, int videoShowingDelay) {
+    if (videoShowingDelay > 0)
+        return waitKey(videoShowingDelay);
+
+    while (true) {
+        int key = waitKey(TIMELINE_POLLING_DELAY);
+        if (key != -1 || timelineStrip->seekFrameNumber >= 0)
+            return key;
+
+        lock_guard <mutex> thumbnailLock(timelineStrip->thumbnailMutex);
+        if (timelineStrip->renderedThumbnailCount != timelineStrip->readyThumbnailCount)
+            return -1;
+    }
+}
 
-            if (label == "t")
-                for (int i = round(firstFrameNumber); i < lastFrameNumber; i++)
-                    positiveFrames->insert(i);
-            else
-                for (int i = round(firstFrameNumber); i < lastFrameNumber; i++)
-                    negativeFrames->insert(i);
-        }
+/** Mouse callback of the window, seeking the video to the frame under the mouse when the
+ *  timeline strip <userData> is clicked or dragged over. */
+void onTimelineMouse(int event, int x, int y, int flags, void *userData) {
+    TimelineStrip *timelineStrip = (TimelineStrip *) userData;
+
+    if (timelineStrip->top < 0 || timelineStrip->width <= 0
+        || y < timelineStrip->top
+        || y >= timelineStrip->top + TIMELINE_THUMBNAIL_HEIGHT + TIMELINE_LABEL_BAR_HEIGHT)
+        return;
+
+    if (event == EVENT_LBUTTONDOWN
+        || (event == EVENT_MOUSEMOVE && (flags & EVENT_FLAG_LBUTTON))) {
+        int frameNumber = int(int64_t(x) * timelineStrip->frameCount / timelineStrip->width);
+        timelineStrip->seekFrameNumber = min(max(frameNumber, 0),
+                                             timelineStrip->frameCount - 1);
+    }
+}
 
-    // closes the ETF file
-    etfReader.close();
+/** Height of the header drawn above the shown frames, with the annotation status. */
+const int FRAME_HEADER_HEIGHT = 50;
+
+/** Height of the legend drawn below the shown frames, with the keyboard commands. */
+const int FRAME_LEGEND_HEIGHT = 80;
+
+/** Composer of the frames being shown: the decoded frames are copied into a reused
+ *  <output> image, between a header (redrawn for every frame) and, below, the timeline
+ *  strip and a legend (rendered only once, or again when the size of the frames
+ *  changes). */
+struct FrameComposer {
+    Mat legend;
+    Mat output;
+};
+
+/** Renders the legend of the keyboard commands into the given composer <frameComposer>,
+ *  with the given width <width> and image type <type>. */
+void renderFrameLegend(FrameComposer *frameComposer, int width, int type) {
+    frameComposer->legend = Mat::zeros(FRAME_LEGEND_HEIGHT, width, type);
+
+    string line1 =
+            "[space] play-stop / [r]everse / [+] faster / [-] slower / [f]ull size / [q]uit";
+    string line2 =
+            "[a] previous / [s] next / [w] previous 100 / [z] next 100 / [b]egin / [e]nd";
+    string line3 =
+            "[0] negative / [1] positive / [j] previous mark / [k] next mark / [l] record label / [t]imes";
+    string line4 =
+            "[[] previous shot / []] next shot / [p] positive shot / [x] negative shot / [n]ext video";
+    putText(frameComposer->legend, line1, Point(10, 15), FONT_HERSHEY_PLAIN, 1,
+            Scalar(0, 200, 0));
+    putText(frameComposer->legend, line2, Point(10, 35), FONT_HERSHEY_PLAIN, 1,
+            Scalar(0, 200, 0));
+    putText(frameComposer->legend, line3, Point(10, 55), FONT_HERSHEY_PLAIN, 1,
+            Scalar(0, 200, 0));
+    putText(frameComposer->legend, line4, Point(10, 75), FONT_HERSHEY_PLAIN, 1,
+            Scalar(0, 200, 0));
 }
 
-/** Loads video frames into the given buffer <frameBuffer>, accordingly to the
- *  given frame number interval [<initialFrameNumber>, <finalFrameNumber>),
- *  from the given list of frame file paths <frameFilePaths>.
- *
- *  Visually adjusts the read frame to contain some program operation info. */
-void loadVideoFrames(vector <Mat> *frameBuffer, int initialFrameNumber,
-                     int finalFrameNumber, vector <string> *frameFilePaths) {
-    for (int i = initialFrameNumber; i < finalFrameNumber; i++) {
-        Mat currentFrame = imread(frameFilePaths->at(i));
-
-        Mat treatedFrame = Mat::zeros(50, currentFrame.cols,
-                                      currentFrame.type());
-        treatedFrame.push_back(currentFrame);
-
-        Mat frameFootnote = Mat::zeros(60, currentFrame.cols,
-                                       currentFrame.type());
-        string line1 =
-                "[space] play-stop / [r]everse / [+] faster / [-] slower / [q]uit";
-        string line2 =
-                "[a] previous / [s] next / [w] previous 100 / [z] next 100 / [b]egin / [e]nd";
-        string line3 =
-                "[0] negative / [1] positive / [j] previous mark / [k] next mark / [l] record label";
-        putText(frameFootnote, line1, Point(10, 15), FONT_HERSHEY_PLAIN, 1,
-                Scalar(0, 200, 0));
-        putText(frameFootnote, line2, Point(10, 35), FONT_HERSHEY_PLAIN, 1,
-                Scalar(0, 200, 0));
-        putText(frameFootnote, line3, Point(10, 55), FONT_HERSHEY_PLAIN, 1,
-                Scalar(0, 200, 0));
-        treatedFrame.push_back(frameFootnote);
-
-        frameBuffer->push_back(treatedFrame);
-    }
-}
-
-/** Loads the video frames related to the given frame buffer <frameBuffer>,
- *  accordingly to the given first frame number of reference
- *  <refCurrentBufferedFrameNumber>.
- *
- *  Parameter <next> is TRUE if the buffer to be filled refers to the next
- *  frames to be shown, FALSE otherwise.
- *
- *  Parameter <frameFilePaths> contains the file paths to the video frames,
- *  previously extracted.
- *
- *  Parameter <loadVideoFramesMutex> is a mutex to control the access to the
- *  given buffer. */
-void loadVideoFrameBuffer(vector <Mat> *frameBuffer,
-                          int *refCurrentBufferedFrameNumber, bool next,
-                          vector <string> *frameFilePaths, Mutex *loadVideoFramesMutex) {
-    while (!frameFilePaths->empty())
-        if (frameBuffer->empty()) {
-            loadVideoFramesMutex->lock();
-
-            int initialFrameNumber, finalFrameNumber;
-            if (next) {
-                initialFrameNumber = *refCurrentBufferedFrameNumber
-                                     + VIDEO_FRAME_BUFFERS_SIZE;
-                if (initialFrameNumber >= frameFilePaths->size())
-                    initialFrameNumber = *refCurrentBufferedFrameNumber;
-
-                finalFrameNumber = initialFrameNumber
-                                   + VIDEO_FRAME_BUFFERS_SIZE;
-                if (finalFrameNumber >= frameFilePaths->size())
-                    finalFrameNumber = frameFilePaths->size();
-            } else {
-                initialFrameNumber = *refCurrentBufferedFrameNumber
-                                     - VIDEO_FRAME_BUFFERS_SIZE;
-                if (initialFrameNumber < 0)
-                    initialFrameNumber = 0;
-
-                finalFrameNumber = initialFrameNumber
-                                   + VIDEO_FRAME_BUFFERS_SIZE;
-                if (finalFrameNumber >= frameFilePaths->size())
-                    finalFrameNumber = frameFilePaths->size();
-            }
+/** Composes the given decoded frame <frame> into the output of the given composer
+ *  <frameComposer>, between an empty header and, below, the thumbnails of the given
+ *  timeline strip <timelineStrip> and the legend of the keyboard commands. The output
+ *  is only reallocated when the size of the frames changes. */
+void composeFrame(FrameComposer *frameComposer, Mat frame, TimelineStrip *timelineStrip) {
+    if (frameComposer->legend.cols != frame.cols
+        || frameComposer->legend.type() != frame.type())
+        renderFrameLegend(frameComposer, frame.cols, frame.type());
+    renderTimelineStrip(timelineStrip, frame.cols);
+
+    int timelineHeight = timelineStrip->renderedStrip.rows;
+    Mat *output = &frameComposer->output;
+    output->create(FRAME_HEADER_HEIGHT + frame.rows + timelineHeight + FRAME_LEGEND_HEIGHT,
+                   frame.cols, frame.type());
+
+    Mat header = output->rowRange(0, FRAME_HEADER_HEIGHT);
+    header.setTo(Scalar(0, 0, 0));
+
+    Mat body = output->rowRange(FRAME_HEADER_HEIGHT, FRAME_HEADER_HEIGHT + frame.rows);
+    frame.copyTo(body);
+
+    timelineStrip->top = FRAME_HEADER_HEIGHT + frame.rows;
+    timelineStrip->width = frame.cols;
+    Mat timeline = output->rowRange(timelineStrip->top, timelineStrip->top + timelineHeight);
+    timelineStrip->renderedStrip.copyTo(timeline);
+
+    Mat footnote = output->rowRange(timelineStrip->top + timelineHeight, output->rows);
+    frameComposer->legend.copyTo(footnote);
+}
 
-            loadVideoFrames(frameBuffer, initialFrameNumber, finalFrameNumber,
-                            frameFilePaths);
+/** Clock of the video playback, presenting the frames at wall-clock times spaced by the
+ *  playback delay, instead of waiting such delay after all the per-frame work. When
+ *  the presentation runs late, the frames that are due are skipped on the screen
+ *  (they are still labeled), and counted as dropped. */
+struct PlaybackClock {
+    chrono::steady_clock::time_point nextPresentationTime;
+    int videoShowingDelay; // delay the clock runs with (0 if stopped)
+    int droppedFrameCount;
+    deque <chrono::steady_clock::time_point> presentationTimes; // within the last second
+};
+
+/** (Re)starts the given clock <playbackClock> with the playback delay <videoShowingDelay>
+ *  (0 for stopped), clearing its statistics. */
+void restartPlaybackClock(PlaybackClock *playbackClock, int videoShowingDelay) {
+    playbackClock->videoShowingDelay = videoShowingDelay;
+    playbackClock->nextPresentationTime = chrono::steady_clock::now()
+                                          + chrono::milliseconds(videoShowingDelay);
+    playbackClock->droppedFrameCount = 0;
+    playbackClock->presentationTimes.clear();
+}
 
-            loadVideoFramesMutex->unlock();
-        } else
-            // put thread to sleep
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+/** Registers, in the given clock <playbackClock>, that a frame is being presented. */
+void registerFramePresentation(PlaybackClock *playbackClock) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    playbackClock->presentationTimes.push_back(now);
+    while (now - playbackClock->presentationTimes.front() > chrono::seconds(1))
+        playbackClock->presentationTimes.pop_front();
+}
+
+/** Returns the frame rate achieved by the given clock <playbackClock> within the last
+ *  second, or ZERO if it is still unknown. */
+double getAchievedFPS(PlaybackClock *playbackClock) {
+    if (playbackClock->presentationTimes.size() < 2)
+        return 0;
+
+    chrono::duration<double> elapsedTime = playbackClock->presentationTimes.back()
+                                           - playbackClock->presentationTimes.front();
+    return (playbackClock->presentationTimes.size() - 1) / elapsedTime.count();
+}
+
+/** Returns the time (in milliseconds, at least ONE) to wait for the presentation of
+ *  the next frame by the given clock <playbackClock>. */
+int getPresentationWaitTime(PlaybackClock *playbackClock) {
+    auto waitTime = chrono::duration_cast<chrono::milliseconds>(
+            playbackClock->nextPresentationTime - chrono::steady_clock::now());
+    return max(int(waitTime.count()), 1);
+}
+
+/** Returns the number of frames that are due by now, according to the given clock
+ *  <playbackClock>: ZERO if it is still early, ONE if in time, more if late. */
+int getDueFrameCount(PlaybackClock *playbackClock) {
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (now < playbackClock->nextPresentationTime)
+        return 0;
+
+    return 1 + int((now - playbackClock->nextPresentationTime)
+                   / chrono::milliseconds(playbackClock->videoShowingDelay));
+}
+
+/** Advances the given clock <playbackClock> by <frameCount> frames, out of which all but
+ *  the last one were skipped on the screen. If no frame could be advanced (e.g., the
+ *  next one is not loaded yet), the clock is rebased to now, as a stall must not be
+ *  recovered by dropping frames later. */
+void advancePlaybackClock(PlaybackClock *playbackClock, int frameCount) {
+    if (frameCount <= 0) {
+        playbackClock->nextPresentationTime =
+                chrono::steady_clock::now()
+                + chrono::milliseconds(playbackClock->videoShowingDelay);
+        return;
+    }
+
+    playbackClock->nextPresentationTime +=
+            chrono::milliseconds(frameCount * playbackClock->videoShowingDelay);
+    playbackClock->droppedFrameCount += frameCount - 1;
+}
+
+/** Draws, on the given frame <frame>, from the row <top> on, a panel with the counters
+ *  and latencies of the stages measured while annotating. */
+void drawStageTimesPanel(Mat *frame, int top) {
+    int lineCount = STAGE_KEY_WAIT - STAGE_FRAME_READ + 1;
+    rectangle(*frame, Point(0, top), Point(min(frame->cols, 520), top + 20 * lineCount + 10),
+              Scalar(0, 0, 0), -1);
+
+    for (int stage = STAGE_FRAME_READ; stage <= STAGE_KEY_WAIT; stage++) {
+        StageTimer *stageTimer = &STAGE_TIMERS[stage];
+        uint64_t count = stageTimer->count.load(memory_order_relaxed);
+
+        stringstream stageStream;
+        stageStream << STAGE_NAMES[stage] << ": " << count << " runs, mean "
+                    << (count > 0 ? stageTimer->totalMicroseconds.load(memory_order_relaxed)
+                                    / count : 0)
+                    << " us, p99 " << getStageTimeQuantile(stage, 0.99) << " us, max "
+                    << stageTimer->maxMicroseconds.load(memory_order_relaxed) << " us";
+
+        putText(*frame, stageStream.str(),
+                Point(10, top + 20 * (stage - STAGE_FRAME_READ + 1)), FONT_HERSHEY_PLAIN, 1,
+                Scalar(0, 200, 200));
+    }
 }
 
 /** Adjusts the given frame <frame>, preparing it to be shown with some info
@@ -346,11 +3320,18 @@ void loadVideoFrameBuffer(vector <Mat> *frameBuffer,
  *  - The label of the current frame (1 for positive, or 0 for negative), by means of
  *    parameter <currentLabel>;
  *
- *  - The positive and negative already annotated frames, by means of parameters
- *    <positiveFrames> and <negativeFrames>. */
+ *  - The labels of the already annotated frames, by means of parameter
+ *    <frameLabels>;
+ *
+ *  - If the frame is still being loaded (hence, the given frame is a previous one),
+ *    by means of parameter <frameLoading>;
+ *
+ *  - The achieved frame rate and the number of dropped frames of the playback, by means
+ *    of parameter <playbackClock>. */
 void prepareToRenderFrameStatus(Mat *frame, int frameNumber, int framesCount,
                                 int videoShowingDelay, bool playReverse, bool overwriteLabels,
-                                int currentLabel, set<int> *positiveFrames, set<int> *negativeFrames) {
+                                int currentLabel, FrameLabelStore *frameLabels,
+                                bool frameLoading, PlaybackClock *playbackClock) {
     rectangle(*frame, Point(50, 5), Point(1000, 45), Scalar(0, 0, 0), -1);
 
     stringstream controlStream1;
@@ -361,6 +3342,14 @@ void prepareToRenderFrameStatus(Mat *frame, int frameNumber, int framesCount,
         controlStream1 << ", playing @mspf " << videoShowingDelay;
     else
         controlStream1 << ", reverse @mspf " << videoShowingDelay;
+    if (videoShowingDelay > 0) {
+        controlStream1.precision(1);
+        controlStream1 << fixed << " (" << getAchievedFPS(playbackClock) << "/"
+                       << 1000.0 / videoShowingDelay << " fps, "
+                       << playbackClock->droppedFrameCount << " dropped)";
+    }
+    if (frameLoading)
+        controlStream1 << ", loading...";
 
     stringstream controlStream2;
     if (!overwriteLabels)
@@ -374,9 +3363,10 @@ void prepareToRenderFrameStatus(Mat *frame, int frameNumber, int framesCount,
     putText(*frame, controlStream2.str(), Point(55, 40), FONT_HERSHEY_PLAIN, 1,
             Scalar(0, 200, 0));
 
-    if (positiveFrames->find(frameNumber) != positiveFrames->end())
+    int frameLabel = getFrameLabel(frameLabels, frameNumber);
+    if (frameLabel == POSITIVE_LABEL)
         rectangle(*frame, Point(0, 0), Point(40, 40), Scalar(0, 0, 200), -1);
-    else if (negativeFrames->find(frameNumber) != positiveFrames->end())
+    else if (frameLabel == NEGATIVE_LABEL)
         rectangle(*frame, Point(0, 0), Point(40, 40), Scalar(0, 200, 0), -1);
 
     if (overwriteLabels)
@@ -389,9 +3379,6 @@ void prepareToRenderFrameStatus(Mat *frame, int frameNumber, int framesCount,
  *  Parameter <currentVideoFrameNumber> contains the number of the current frame
  *  being shown.
  *
- *  Parameter <refCurrentBufferedFrameNumber> contains the number of the first
- *  frame held at the buffer of current frames.
- *
  *  Parameter <videoShowingDelay> contains the delay used to show the video frames.
  *
  *  Parameter <playReverse> is TRUE if the frames are being shown in reverse mode,
@@ -403,36 +3390,31 @@ void prepareToRenderFrameStatus(Mat *frame, int frameNumber, int framesCount,
  *  Parameter <currentLabel> contains the label of the current frame: 0 for negative,
  *  1 for positive.
  *
- *  Parameter <frameFilePaths> is a list containing the file paths of the video frames,
- *  properly sorted in exhibition time.
+ *  Parameter <showStageTimes> is TRUE if the panel with the stage times is shown,
+ *  FALSE otherwise.
  *
- *  Parameter <currentVideoFrameBuffer> is the buffer of the frames currently being shown.
- *  Parameter <previousVideoFrameBuffer> is the buffer of the frames previously being shown.
- *  Parameter <nextVideoFrameBuffer> is the buffer of the frames supposed to be shown in the
- *  near future.
+ *  Parameter <frameSource> is the source of the video frames, properly sorted in
+ *  exhibition time.
  *
- *  Parameter <positiveFrames> contains the numbers of the video frames already annotated as
- *  positive.
- *  Parameter <negativeFrames> contains the numbers of the video frames already annotated as
- *  negative.
+ *  Parameter <frameLabels> contains the labels of the video frames already annotated, of
+ *  which changes are recorded in the journal <labelJournal>.
  *
- *  Parameter <loadFramesIntoPreviousBufferMutex> is a mutex controlling the access the
- *  <previousVideoFrameBuffer> buffer.
- *  Parameter <loadFramesIntoNextBufferMutex> is a mutex controlling the access the
- *  <nextVideoFrameBuffer> buffer. */
-void treatKeyboardInput(char key, int *currentVideoFrameNumber,
-                        int *refCurrentBufferedFrameNumber, int *videoShowingDelay,
+ *  Parameter <shotBegins> contains the numbers of the first frames of the shots of the
+ *  video. */
+void treatKeyboardInput(char key, int *currentVideoFrameNumber, int *videoShowingDelay,
                         bool *playReverse, bool *overwriteLabels, int *currentLabel,
-                        vector <string> *frameFilePaths, vector <Mat> *currentVideoFrameBuffer,
-                        vector <Mat> *previousVideoFrameBuffer,
-                        vector <Mat> *nextVideoFrameBuffer, set<int> *positiveFrames,
-                        set<int> *negativeFrames, Mutex *loadFramesIntoPreviousBufferMutex,
-                        Mutex *loadFramesIntoNextBufferMutex) {
+                        bool *showStageTimes, VideoFrameSource *frameSource,
+                        FrameLabelStore *frameLabels, LabelJournal *labelJournal,
+                        vector<int> *shotBegins) {
     int frameNumber;
 
     switch (key) {
         case 'q':
-            frameFilePaths->clear(); // makes the program finish and save results
+            frameSource->closed = true; // makes the program finish and save results
+            break;
+
+        case 'n':
+            frameSource->closed = true; // moves to the next video of the session, if any
             break;
 
         case '+':
@@ -477,273 +3459,120 @@ void treatKeyboardInput(char key, int *currentVideoFrameNumber,
             *currentLabel = 1;
             break;
 
+        case 't':
+            *showStageTimes = !(*showStageTimes);
+            break;
+
+        case 'f':
+            // shows the current frame in full size, in a separate window
+            *videoShowingDelay = 0;
+            imshow("Frame Labeler (full size)",
+                   readVideoFrame(frameSource, *currentVideoFrameNumber, 1));
+            break;
+
         case 'a': // left arrow
             *overwriteLabels = false;
             *videoShowingDelay = 0;
             *currentVideoFrameNumber > 0 ?
             (*currentVideoFrameNumber)-- : *currentVideoFrameNumber = 0;
-
-            // if out of buffer
-            if (*currentVideoFrameNumber < *refCurrentBufferedFrameNumber) {
-                loadFramesIntoNextBufferMutex->lock();
-                loadFramesIntoPreviousBufferMutex->lock();
-
-                // the next buffer is the current one
-                nextVideoFrameBuffer->clear();
-                *nextVideoFrameBuffer = *currentVideoFrameBuffer;
-
-                // the current buffer is the previous one
-                currentVideoFrameBuffer->clear();
-                *currentVideoFrameBuffer = *previousVideoFrameBuffer;
-
-                // restarts the previous buffer
-                previousVideoFrameBuffer->clear();
-
-                // updates the reference number of the 1st frame inside the current buffer
-                if (*refCurrentBufferedFrameNumber - VIDEO_FRAME_BUFFERS_SIZE >= 0)
-                    *refCurrentBufferedFrameNumber = *refCurrentBufferedFrameNumber
-                                                     - VIDEO_FRAME_BUFFERS_SIZE;
-                // else maintains the number
-
-                loadFramesIntoNextBufferMutex->unlock();
-                loadFramesIntoPreviousBufferMutex->unlock();
-            }
             break;
 
         case 's': // right arrow
             *videoShowingDelay = 0;
-            *currentVideoFrameNumber < frameFilePaths->size() - 1 ?
+            *currentVideoFrameNumber < frameSource->frameCount - 1 ?
             (*currentVideoFrameNumber)++ :
-                    *currentVideoFrameNumber = frameFilePaths->size() - 1;
-
-            // if out of buffer
-            // (i.e. buffers need to be updated)
-            if (*currentVideoFrameNumber
-                >= *refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE) {
-                loadFramesIntoNextBufferMutex->lock();
-                loadFramesIntoPreviousBufferMutex->lock();
-
-                // the previous buffer is the current one
-                previousVideoFrameBuffer->clear();
-                *previousVideoFrameBuffer = *currentVideoFrameBuffer;
-
-                // the current buffer is the next one
-                currentVideoFrameBuffer->clear();
-                *currentVideoFrameBuffer = *nextVideoFrameBuffer;
-
-                // restarts the next buffer
-                nextVideoFrameBuffer->clear();
-
-                // updates the reference number of the 1st frame inside the current buffer
-                if (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                    < frameFilePaths->size())
-                    *refCurrentBufferedFrameNumber = *refCurrentBufferedFrameNumber
-                                                     + VIDEO_FRAME_BUFFERS_SIZE;
-                // else maintains the number
-
-                loadFramesIntoNextBufferMutex->unlock();
-                loadFramesIntoPreviousBufferMutex->unlock();
-            }
+                    *currentVideoFrameNumber = frameSource->frameCount - 1;
             break;
 
         case 'w': // up arrow
-            loadFramesIntoNextBufferMutex->lock();
-            loadFramesIntoPreviousBufferMutex->lock();
-
             *overwriteLabels = false;
             *videoShowingDelay = 0;
-            *currentVideoFrameNumber < frameFilePaths->size() - FRAME_JUMP_SIZE ?
+            *currentVideoFrameNumber < frameSource->frameCount - FRAME_JUMP_SIZE ?
                     *currentVideoFrameNumber = *currentVideoFrameNumber
                                                + FRAME_JUMP_SIZE :
-                    *currentVideoFrameNumber = frameFilePaths->size() - 1;
-            *refCurrentBufferedFrameNumber = int(
-                    *currentVideoFrameNumber / VIDEO_FRAME_BUFFERS_SIZE)
-                                             * VIDEO_FRAME_BUFFERS_SIZE;
-
-            currentVideoFrameBuffer->clear();
-            previousVideoFrameBuffer->clear();
-            nextVideoFrameBuffer->clear();
-
-            loadFramesIntoNextBufferMutex->unlock();
-            loadFramesIntoPreviousBufferMutex->unlock();
-
-            // gathers the current buffer of frames
-            loadVideoFrames(currentVideoFrameBuffer, *refCurrentBufferedFrameNumber,
-                            (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                             < frameFilePaths->size() ?
-                             *refCurrentBufferedFrameNumber
-                             + VIDEO_FRAME_BUFFERS_SIZE :
-                             frameFilePaths->size()), frameFilePaths);
+                    *currentVideoFrameNumber = frameSource->frameCount - 1;
             break;
 
         case 'z': // down arrow
-            loadFramesIntoNextBufferMutex->lock();
-            loadFramesIntoPreviousBufferMutex->lock();
-
             *overwriteLabels = false;
             *videoShowingDelay = 0;
             *currentVideoFrameNumber > FRAME_JUMP_SIZE ?
                     *currentVideoFrameNumber = *currentVideoFrameNumber
                                                - FRAME_JUMP_SIZE :
                     *currentVideoFrameNumber = 0;
-            *refCurrentBufferedFrameNumber = int(
-                    *currentVideoFrameNumber / VIDEO_FRAME_BUFFERS_SIZE)
-                                             * VIDEO_FRAME_BUFFERS_SIZE;
-
-            currentVideoFrameBuffer->clear();
-            previousVideoFrameBuffer->clear();
-            nextVideoFrameBuffer->clear();
-
-            loadFramesIntoNextBufferMutex->unlock();
-            loadFramesIntoPreviousBufferMutex->unlock();
-
-            // gathers the current buffer of frames
-            loadVideoFrames(currentVideoFrameBuffer, *refCurrentBufferedFrameNumber,
-                            (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                             < frameFilePaths->size() ?
-                             *refCurrentBufferedFrameNumber
-                             + VIDEO_FRAME_BUFFERS_SIZE :
-                             frameFilePaths->size()), frameFilePaths);
             break;
 
         case 'b':
-            loadFramesIntoNextBufferMutex->lock();
-            loadFramesIntoPreviousBufferMutex->lock();
-
             *overwriteLabels = false;
             *videoShowingDelay = 0;
             *currentVideoFrameNumber = 0;
-            *refCurrentBufferedFrameNumber = 0;
-
-            currentVideoFrameBuffer->clear();
-            previousVideoFrameBuffer->clear();
-            nextVideoFrameBuffer->clear();
-
-            loadFramesIntoNextBufferMutex->unlock();
-            loadFramesIntoPreviousBufferMutex->unlock();
-
-            // gathers the current buffer of frames
-            loadVideoFrames(currentVideoFrameBuffer, *refCurrentBufferedFrameNumber,
-                            (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                             < frameFilePaths->size() ?
-                             *refCurrentBufferedFrameNumber
-                             + VIDEO_FRAME_BUFFERS_SIZE :
-                             frameFilePaths->size()), frameFilePaths);
             break;
 
         case 'e':
-            loadFramesIntoNextBufferMutex->lock();
-            loadFramesIntoPreviousBufferMutex->lock();
-
             *overwriteLabels = false;
             *videoShowingDelay = 0;
-            *currentVideoFrameNumber = frameFilePaths->size() - 1;
-            *refCurrentBufferedFrameNumber = int(
-                    *currentVideoFrameNumber / VIDEO_FRAME_BUFFERS_SIZE)
-                                             * VIDEO_FRAME_BUFFERS_SIZE;
-
-            currentVideoFrameBuffer->clear();
-            previousVideoFrameBuffer->clear();
-            nextVideoFrameBuffer->clear();
-
-            loadFramesIntoNextBufferMutex->unlock();
-            loadFramesIntoPreviousBufferMutex->unlock();
-
-            // gathers the current buffer of frames
-            loadVideoFrames(currentVideoFrameBuffer, *refCurrentBufferedFrameNumber,
-                            (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                             < frameFilePaths->size() ?
-                             *refCurrentBufferedFrameNumber
-                             + VIDEO_FRAME_BUFFERS_SIZE :
-                             frameFilePaths->size()), frameFilePaths);
+            *currentVideoFrameNumber = frameSource->frameCount - 1;
             break;
 
         case 'j':
-            loadFramesIntoNextBufferMutex->lock();
-            loadFramesIntoPreviousBufferMutex->lock();
-
             frameNumber = *currentVideoFrameNumber;
 
-            if (frameNumber > 0) {
-                frameNumber--;
-
-                if (positiveFrames->find(frameNumber) != positiveFrames->end())
-                    while (positiveFrames->find(frameNumber)
-                           != positiveFrames->end())
-                        frameNumber--;
-                else
-                    while (negativeFrames->find(frameNumber)
-                           != negativeFrames->end())
-                        frameNumber--;
-
-                frameNumber++;
-            }
+            // beginning of the labeled run containing the previous frame
+            if (frameNumber > 0)
+                frameNumber = getLabelRunBegin(frameLabels, frameNumber - 1);
 
             *overwriteLabels = false;
             *videoShowingDelay = 0;
             *currentVideoFrameNumber = frameNumber;
-            *refCurrentBufferedFrameNumber = int(
-                    *currentVideoFrameNumber / VIDEO_FRAME_BUFFERS_SIZE)
-                                             * VIDEO_FRAME_BUFFERS_SIZE;
-
-            currentVideoFrameBuffer->clear();
-            previousVideoFrameBuffer->clear();
-            nextVideoFrameBuffer->clear();
-
-            loadFramesIntoNextBufferMutex->unlock();
-            loadFramesIntoPreviousBufferMutex->unlock();
-
-            // gathers the current buffer of frames
-            loadVideoFrames(currentVideoFrameBuffer, *refCurrentBufferedFrameNumber,
-                            (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                             < frameFilePaths->size() ?
-                             *refCurrentBufferedFrameNumber
-                             + VIDEO_FRAME_BUFFERS_SIZE :
-                             frameFilePaths->size()), frameFilePaths);
             break;
 
         case 'k':
-            loadFramesIntoNextBufferMutex->lock();
-            loadFramesIntoPreviousBufferMutex->lock();
+            frameNumber = *currentVideoFrameNumber;
+
+            // end of the labeled run containing the next frame
+            if (frameNumber < frameSource->frameCount - 1)
+                frameNumber = getLabelRunEnd(frameLabels, frameNumber + 1);
+
+            *overwriteLabels = false;
+            *videoShowingDelay = 0;
+            *currentVideoFrameNumber = (
+                    frameNumber < frameSource->frameCount ?
+                    frameNumber : frameSource->frameCount - 1);
+            break;
 
+        case '[':
             frameNumber = *currentVideoFrameNumber;
 
-            if (frameNumber < frameFilePaths->size() - 1) {
-                frameNumber++;
+            // beginning of the shot containing the previous frame
+            if (frameNumber > 0)
+                frameNumber = getShotBegin(shotBegins, frameNumber - 1);
 
-                if (positiveFrames->find(frameNumber) != positiveFrames->end())
-                    while (positiveFrames->find(frameNumber)
-                           != positiveFrames->end())
-                        frameNumber++;
-                else
-                    while (negativeFrames->find(frameNumber)
-                           != negativeFrames->end())
-                        frameNumber++;
-            }
+            *overwriteLabels = false;
+            *videoShowingDelay = 0;
+            *currentVideoFrameNumber = frameNumber;
+            break;
+
+        case ']':
+            // beginning of the next shot
+            frameNumber = getShotEnd(shotBegins, *currentVideoFrameNumber,
+                                     frameSource->frameCount);
 
             *overwriteLabels = false;
             *videoShowingDelay = 0;
             *currentVideoFrameNumber = (
-                    frameNumber < frameFilePaths->size() ?
-                    frameNumber : frameFilePaths->size() - 1);
-            *refCurrentBufferedFrameNumber = int(
-                    *currentVideoFrameNumber / VIDEO_FRAME_BUFFERS_SIZE)
-                                             * VIDEO_FRAME_BUFFERS_SIZE;
-
-            currentVideoFrameBuffer->clear();
-            previousVideoFrameBuffer->clear();
-            nextVideoFrameBuffer->clear();
-
-            loadFramesIntoNextBufferMutex->unlock();
-            loadFramesIntoPreviousBufferMutex->unlock();
-
-            // gathers the current buffer of frames
-            loadVideoFrames(currentVideoFrameBuffer, *refCurrentBufferedFrameNumber,
-                            (*refCurrentBufferedFrameNumber + VIDEO_FRAME_BUFFERS_SIZE
-                             < frameFilePaths->size() ?
-                             *refCurrentBufferedFrameNumber
-                             + VIDEO_FRAME_BUFFERS_SIZE :
-                             frameFilePaths->size()), frameFilePaths);
+                    frameNumber < frameSource->frameCount ?
+                    frameNumber : frameSource->frameCount - 1);
+            break;
+
+        case 'p':
+        case 'x':
+            // labels the whole current shot as positive ('p') or negative ('x')
+            *overwriteLabels = false;
+            *videoShowingDelay = 0;
+            *currentLabel = (key == 'p' ? POSITIVE_LABEL : NEGATIVE_LABEL);
+            recordFrameLabels(labelJournal, getShotBegin(shotBegins, *currentVideoFrameNumber),
+                              getShotEnd(shotBegins, *currentVideoFrameNumber,
+                                         frameSource->frameCount), *currentLabel);
             break;
 
         default:
@@ -751,293 +3580,324 @@ void treatKeyboardInput(char key, int *currentVideoFrameNumber,
     }
 }
 
-/** Shows the frames related to the given file paths <frameFilePaths>.
- *
- *  Parameters <positiveFrames> and <negativeFrames> are sets containing the
- *  numbers of the positive and of the negative frames, respectively. */
-void showVideoFrames(vector <string> *frameFilePaths, set<int> *positiveFrames,
-                     set<int> *negativeFrames) {
-    // delay to show video frames (milliseconds per frame, MSPF)
-    int videoShowingDelay = 0; // 0: wait key
+/** Script of keys to be replayed headless (i.e., with no window), instead of read from
+ *  the keyboard. Each key is pressed a given delay (in milliseconds) after the previous
+ *  one, and its latency is measured until the next frame is presented. */
+struct KeyScript {
+    vector <pair<int, char>> keys; // delay, key
+    int nextKeyPosition;
+    chrono::steady_clock::time_point nextKeyTime;
+
+    // key pressed, whose frame was not presented yet
+    bool keyPending;
+    char pendingKey;
+    chrono::steady_clock::time_point pendingKeyTime;
+
+    // latencies (in milliseconds) of the pressed keys
+    map<char, vector<double>> keyLatencies;
+};
+
+/** Reads the key script of the given file <keyScriptFilePath> into <keyScript>. Each
+ *  line holds the delay (in milliseconds, after the previous key) and the key (a single
+ *  character, or "space"); lines beginning with '#' are ignored. */
+void readKeyScript(string keyScriptFilePath, KeyScript *keyScript) {
+    ifstream scriptReader(keyScriptFilePath.data());
+    if (scriptReader.fail()) {
+        cerr << "Could not open file " << keyScriptFilePath << "." << endl;
+        throw -1;
+    }
 
-    // buffers that hold the frames of the video being annotated
-    vector <Mat> currentVideoFrameBuffer, previousVideoFrameBuffer,
-            nextVideoFrameBuffer;
+    string scriptLine;
+    while (getline(scriptReader, scriptLine)) {
+        if (scriptLine.empty() || scriptLine[0] == '#')
+            continue;
 
-    // holds the number of the first frame put in the current buffer
-    int refCurrentBufferFrameNumber = 0;
+        stringstream scriptLineStream;
+        scriptLineStream << scriptLine;
 
-    // holds the number of the video frame currently being shown
-    int currentVideoFrameNumber = 0;
+        int delay = -1;
+        string key;
+        scriptLineStream >> delay >> key;
+        if (scriptLineStream.fail() || delay < 0 || (key.length() != 1 && key != "space")) {
+            cerr << "File " << keyScriptFilePath << " is not a valid key script." << endl;
+            throw -2;
+        }
 
-    // indicates if the video is supposed to be displayed in reversed order
-    bool playReverse = false;
+        keyScript->keys.push_back(make_pair(delay, key == "space" ? ' ' : key[0]));
+    }
+    scriptReader.close();
 
-    // indicates if the labels are to be overwritten
-    bool overwriteLabels = false;
+    keyScript->nextKeyPosition = 0;
+    keyScript->keyPending = false;
+}
 
-    // holds the current label to give to the played frames:
-    // 0 for negative, 1 for positive
-    int currentLabel = 0;
+/** Starts the replay of the given key script <keyScript>, scheduling its first key. */
+void startKeyScript(KeyScript *keyScript) {
+    keyScript->nextKeyTime = chrono::steady_clock::now();
+    if (!keyScript->keys.empty())
+        keyScript->nextKeyTime += chrono::milliseconds(keyScript->keys.front().first);
+}
 
-    // mutexes to control the filling of the frame buffers
-    Mutex *loadFramesIntoPreviousBufferMutex = new Mutex();
-    Mutex *loadFramesIntoNextBufferMutex = new Mutex();
-    // threads to keep on feeding the buffers
-    thread *previousBufferThread = new thread(loadVideoFrameBuffer, &previousVideoFrameBuffer,
-                                              &refCurrentBufferFrameNumber, false, frameFilePaths,
-                                              loadFramesIntoPreviousBufferMutex);
-    thread *nextBufferThread = new thread(loadVideoFrameBuffer, &nextVideoFrameBuffer,
-                                          &refCurrentBufferFrameNumber, true, frameFilePaths,
-                                          loadFramesIntoNextBufferMutex);
-
-    // gathers the current buffer of frames
-    while (currentVideoFrameBuffer.empty()) {
-        loadFramesIntoPreviousBufferMutex->lock();
-        currentVideoFrameBuffer = previousVideoFrameBuffer;
-        loadFramesIntoPreviousBufferMutex->unlock();
-    }
-
-    // keeps on showing the video frames, until 'q' is pressed
-    // (it will clear frameFilePaths)
-    while (!frameFilePaths->empty()) {
-        Mat currentFrame;
+/** Replaces waitKey while replaying the given key script <keyScript>: waits for
+ *  <waitTime> milliseconds (or indefinitely, if ZERO) for the next scripted key. Returns
+ *  the key, -1 if none is due within the given time, or 'q' once the script is over. */
+int waitScriptedKey(KeyScript *keyScript, int waitTime) {
+    if (keyScript->nextKeyPosition >= keyScript->keys.size())
+        return 'q';
+
+    if (waitTime > 0 && chrono::steady_clock::now() + chrono::milliseconds(waitTime)
+                        < keyScript->nextKeyTime) {
+        this_thread::sleep_for(chrono::milliseconds(waitTime));
+        return -1;
+    }
+    this_thread::sleep_until(keyScript->nextKeyTime);
+
+    // presses the key, scheduling the next one (drift-free)
+    char key = keyScript->keys.at(keyScript->nextKeyPosition).second;
+    keyScript->nextKeyPosition++;
+    if (keyScript->nextKeyPosition < keyScript->keys.size())
+        keyScript->nextKeyTime += chrono::milliseconds(
+                keyScript->keys.at(keyScript->nextKeyPosition).first);
+
+    keyScript->keyPending = true;
+    keyScript->pendingKey = key;
+    keyScript->pendingKeyTime = chrono::steady_clock::now();
+    return key;
+}
 
-        if (currentVideoFrameNumber >= 0
-            && currentVideoFrameNumber < frameFilePaths->size()) {
-            currentVideoFrameBuffer.at(
-                    currentVideoFrameNumber % VIDEO_FRAME_BUFFERS_SIZE).copyTo(
-                    currentFrame);
+/** Registers, in the given key script <keyScript>, that a frame was presented, measuring
+ *  the latency of the pending key, if any. */
+void registerScriptedFramePresentation(KeyScript *keyScript) {
+    if (!keyScript->keyPending)
+        return;
 
-            // treats possible changes in the current frame label
-            if (currentLabel == 0 && overwriteLabels) {
-                positiveFrames->erase(currentVideoFrameNumber);
-                negativeFrames->insert(currentVideoFrameNumber);
-            } else if (currentLabel == 1 && overwriteLabels) {
-                positiveFrames->insert(currentVideoFrameNumber);
-                negativeFrames->erase(currentVideoFrameNumber);
-            }
+    chrono::duration<double, milli> latency = chrono::steady_clock::now()
+                                              - keyScript->pendingKeyTime;
+    keyScript->keyLatencies[keyScript->pendingKey].push_back(latency.count());
+    keyScript->keyPending = false;
+}
 
-            // prepares the current frame to be rendered
-            prepareToRenderFrameStatus(&currentFrame, currentVideoFrameNumber,
-                                       frameFilePaths->size() - 1, videoShowingDelay, playReverse,
-                                       overwriteLabels, currentLabel, positiveFrames,
-                                       negativeFrames);
-
-            // increases the current frame number
-            // and prepares the buffers, if it is the case
-            if (videoShowingDelay > 0) {
-                // if the video is being played not reversed
-                if (!playReverse
-                    && currentVideoFrameNumber < frameFilePaths->size() - 1
-                    && !nextVideoFrameBuffer.empty()) {
-                    // next frame
-                    currentVideoFrameNumber++;
-
-                    // if out of buffer
-                    // (i.e. buffers need to be updated)
-                    if (currentVideoFrameNumber
-                        >= refCurrentBufferFrameNumber
-                           + VIDEO_FRAME_BUFFERS_SIZE) {
-                        loadFramesIntoNextBufferMutex->lock();
-                        loadFramesIntoPreviousBufferMutex->lock();
-
-                        // the previous buffer is the current one
-                        previousVideoFrameBuffer.clear();
-                        previousVideoFrameBuffer = currentVideoFrameBuffer;
-
-                        // the current buffer is the next one
-                        currentVideoFrameBuffer = nextVideoFrameBuffer;
-
-                        // restarts the next buffer
-                        nextVideoFrameBuffer = vector<Mat>();
-
-                        // updates the reference number of the 1st frame inside the current buffer
-                        if (refCurrentBufferFrameNumber
-                            + VIDEO_FRAME_BUFFERS_SIZE
-                            < frameFilePaths->size())
-                            refCurrentBufferFrameNumber =
-                                    refCurrentBufferFrameNumber
-                                    + VIDEO_FRAME_BUFFERS_SIZE;
-                        // else maintains the number
-
-                        loadFramesIntoNextBufferMutex->unlock();
-                        loadFramesIntoPreviousBufferMutex->unlock();
-                    }
-                }
+/** Reports the replay of the given key script <keyScript>: the latency percentiles of
+ *  each key, the hit rate of the frame cache of <prefetcher>, and the final state of the
+ *  labels <frameLabels>. */
+void reportKeyScriptReplay(KeyScript *keyScript, FramePrefetcher *prefetcher,
+                           FrameLabelStore *frameLabels) {
+    cout << "Key script replay:" << endl;
+    for (auto &keyLatencies : keyScript->keyLatencies) {
+        vector<double> *latencies = &keyLatencies.second;
+        sort(latencies->begin(), latencies->end());
+
+        char reportLine[256];
+        snprintf(reportLine, sizeof(reportLine),
+                 " key '%c': %zu presses, latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms,"
+                 " max %.2f ms", keyLatencies.first, latencies->size(),
+                 latencies->at(latencies->size() / 2),
+                 latencies->at(latencies->size() * 9 / 10),
+                 latencies->at(latencies->size() * 99 / 100), latencies->back());
+        cout << reportLine << endl;
+    }
 
-                    // else, the video is being played reversed
-                else if (playReverse && currentVideoFrameNumber > 0
-                         && !previousVideoFrameBuffer.empty()) {
-                    // previous frame
-                    currentVideoFrameNumber--;
-
-                    // if out of buffer
-                    if (currentVideoFrameNumber < refCurrentBufferFrameNumber) {
-                        loadFramesIntoNextBufferMutex->lock();
-                        loadFramesIntoPreviousBufferMutex->lock();
-
-                        // the next buffer is the current one
-                        nextVideoFrameBuffer.clear();
-                        nextVideoFrameBuffer = currentVideoFrameBuffer;
-
-                        // the current buffer is the previous one
-                        currentVideoFrameBuffer = previousVideoFrameBuffer;
-
-                        // restarts the previous buffer
-                        previousVideoFrameBuffer = vector<Mat>();
-
-                        // updates the reference number of the 1st frame inside the current buffer
-                        if (refCurrentBufferFrameNumber
-                            - VIDEO_FRAME_BUFFERS_SIZE >= 0)
-                            refCurrentBufferFrameNumber =
-                                    refCurrentBufferFrameNumber
-                                    - VIDEO_FRAME_BUFFERS_SIZE;
-                        // else maintains the number
-
-                        loadFramesIntoNextBufferMutex->unlock();
-                        loadFramesIntoPreviousBufferMutex->unlock();
-                    }
-                }
-            }
+    int requestCount = prefetcher->cacheHitCount + prefetcher->cacheMissCount;
+    cout << " frame cache: " << prefetcher->cacheHitCount << "/" << requestCount
+         << " hits (" << (requestCount > 0 ? 100.0 * prefetcher->cacheHitCount / requestCount : 0)
+         << "%)" << endl;
+
+    int positiveFrameCount = 0, positiveRunCount = 0;
+    for (int runBegin = 0; runBegin < frameLabels->frameCount;) {
+        int runEnd = getLabelRunEnd(frameLabels, runBegin);
+        if (getFrameLabel(frameLabels, runBegin) == POSITIVE_LABEL) {
+            positiveFrameCount = positiveFrameCount + runEnd - runBegin;
+            positiveRunCount++;
         }
-
-        // shows the current frame
-        namedWindow("Frame Labeler", WINDOW_AUTOSIZE);
-        imshow("Frame Labeler", currentFrame);
-        char key = waitKey(videoShowingDelay);
-
-        // treats an eventual pressed key
-        treatKeyboardInput(key, &currentVideoFrameNumber,
-                           &refCurrentBufferFrameNumber, &videoShowingDelay, &playReverse,
-                           &overwriteLabels, &currentLabel, frameFilePaths,
-                           &currentVideoFrameBuffer, &previousVideoFrameBuffer,
-                           &nextVideoFrameBuffer, positiveFrames, negativeFrames,
-                           loadFramesIntoPreviousBufferMutex,
-                           loadFramesIntoNextBufferMutex);
+        runBegin = runEnd;
     }
-
-    // frees some memory
-    nextBufferThread->join();
-    previousBufferThread->join();
-    delete nextBufferThread;
-    delete previousBufferThread;
-    delete loadFramesIntoNextBufferMutex;
-    delete loadFramesIntoPreviousBufferMutex;
+    cout << " final labels: " << positiveFrameCount << "/" << frameLabels->frameCount
+         << " positive frames, in " << positiveRunCount << " runs" << endl;
 }
 
-/** Generates and saves the ETF file in the given path <etfFilePath>.
+/** Shows the frames of the given frame source <frameSource>.
  *
- *  Parameter <event> is a string containing the name of annotated event.
+ *  Parameter <frameLabels> is the store of the labels of the frames, of which changes
+ *  are recorded in the journal <labelJournal>.
  *
- *  Parameter <videoFPS> defines the frame rate of the annotated video.
+ *  Parameter <initialFrameNumber> is the number of the first frame to be shown.
  *
- *  Parameter <videoFileName> contains the file name of the annotated video.
+ *  Parameter <timelineStrip> is the timeline strip shown below the frames, to seek
+ *  them with the mouse.
  *
- *  Parameter <totalFramesCount> contains the total number of frames extracted
- *  from the annotated video.
+ *  Parameter <keyScript> is a script of keys to be replayed headless, instead of showing
+ *  the frames in a window and reading the keyboard, or NULL if none.
  *
- *  Parameters <positiveFrames> and <negativeFrames> are sets containing the
- *  numbers of the positive and of the negative annotated frames, respectively.
+ *  Parameter <preloadedFrames> holds frames already loaded in background, to be shown
+ *  right away, or NULL if none.
  *
- *  ETF file: format created within the MediaEval (https://multimediaeval.github.io/ violent scenes loc. task. */
-void generateAndSaveETFFile(string etfFilePath, string event, double videoFPS,
-                            string videoFileName, int totalFramesCount, set<int> *positiveFrames,
-                            set<int> *negativeFrames) {
-    // turns the sets into vectors
-    vector<int> positiveFramesVector, negativeFramesVector;
-    if (!positiveFrames->empty())
-        positiveFramesVector = vector<int>(positiveFrames->begin(),
-                                           positiveFrames->end());
-    if (!negativeFrames->empty())
-        negativeFramesVector = vector<int>(negativeFrames->begin(),
-                                           negativeFrames->end());
-
-    // holds the time marks
-    vector<int> videoTimeMarks;
-    videoTimeMarks.push_back(0);
-    bool beginsNegative;
-
-    // there are only negative marks
-    if (positiveFramesVector.empty() && !negativeFramesVector.empty())
-        beginsNegative = true;
-
-        // there are only positive marks
-    else if (!positiveFramesVector.empty() && negativeFramesVector.empty())
-        beginsNegative = false;
-
-        // there are negative and positive marks
-    else {
-        if (negativeFramesVector.front() < positiveFramesVector.front()) {
-            beginsNegative = true;
+ *  Parameter <shotBegins> contains the numbers of the first frames of the shots of the
+ *  video, to navigate and label them as a whole.
+ *
+ *  Returns TRUE if the annotator asked for the next video ('n'), FALSE if they quit. */
+bool showVideoFrames(VideoFrameSource *frameSource, FrameLabelStore *frameLabels,
+                     LabelJournal *labelJournal, int initialFrameNumber,
+                     TimelineStrip *timelineStrip, KeyScript *keyScript,
+                     VideoFrameCache *preloadedFrames, vector<int> *shotBegins) {
+    // delay to show video frames (milliseconds per frame, MSPF)
+    int videoShowingDelay = 0; // 0: wait key
 
-            videoTimeMarks.push_back(positiveFramesVector.front());
-            int lastPositive = positiveFramesVector.front();
+    // holds the number of the video frame currently being shown
+    int currentVideoFrameNumber = min(max(initialFrameNumber, 0), frameSource->frameCount - 1);
 
-            for (int i = 1; i < positiveFramesVector.size(); i++) {
-                if (lastPositive + 1 != positiveFramesVector.at(i)) {
-                    videoTimeMarks.push_back(
-                            positiveFramesVector.at(i - 1) + 1);
-                    videoTimeMarks.push_back(positiveFramesVector.at(i));
-                }
+    // indicates if the video is supposed to be displayed in reversed order
+    bool playReverse = false;
 
-                lastPositive = positiveFramesVector.at(i);
-            }
+    // indicates if the labels are to be overwritten
+    bool overwriteLabels = false;
 
-            videoTimeMarks.push_back(positiveFramesVector.back() + 1);
-        } else {
-            beginsNegative = false;
+    // holds the current label to give to the played frames:
+    // 0 for negative, 1 for positive
+    int currentLabel = 0;
 
-            videoTimeMarks.push_back(negativeFramesVector.front());
-            int lastNegative = negativeFramesVector.front();
+    // prefetcher to keep on feeding the frame cache
+    FramePrefetcher *prefetcher = new FramePrefetcher();
+    startFramePrefetcher(prefetcher, frameSource, currentVideoFrameNumber, preloadedFrames);
 
-            for (int i = 1; i < negativeFramesVector.size(); i++) {
-                if (lastNegative + 1 != negativeFramesVector.at(i)) {
-                    videoTimeMarks.push_back(
-                            negativeFramesVector.at(i - 1) + 1);
-                    videoTimeMarks.push_back(negativeFramesVector.at(i));
-                }
+    // indicates if the panel with the stage times is to be shown
+    bool showStageTimes = false;
+
+    // clock of the playback
+    PlaybackClock playbackClock;
+    restartPlaybackClock(&playbackClock, 0);
+
+    // composer of the shown frames, reusing its output image
+    FrameComposer frameComposer;
+    Mat currentFrame;
 
-                lastNegative = negativeFramesVector.at(i);
+    if (keyScript == NULL) {
+        namedWindow("Frame Labeler", WINDOW_AUTOSIZE);
+        setMouseCallback("Frame Labeler", onTimelineMouse, timelineStrip);
+    } else
+        startKeyScript(keyScript);
+
+    // keeps on showing the video frames, until 'q' or 'n' is pressed
+    // (it will close frameSource)
+    char key = -1;
+    while (!frameSource->closed) {
+        // tells if the current frame is still being loaded in background
+        bool frameLoading = false;
+
+        if (currentVideoFrameNumber >= 0
+            && currentVideoFrameNumber < frameSource->frameCount) {
+            // waits for the current frame only briefly, unless nothing was shown yet;
+            // meanwhile, the previously shown frame is kept on the screen
+            Mat decodedFrame;
+            bool frameReady = waitForVideoFrame(
+                    prefetcher, currentVideoFrameNumber,
+                    (currentFrame.empty() ? -1 : FRAME_LOADING_WAIT_TIME), &decodedFrame);
+
+            chrono::steady_clock::time_point composeBeginTime = chrono::steady_clock::now();
+            if (frameReady) {
+                composeFrame(&frameComposer, decodedFrame, timelineStrip);
+                if (keyScript != NULL)
+                    registerScriptedFramePresentation(keyScript);
             }
+            else
+                frameLoading = true;
+            currentFrame = frameComposer.output;
 
-            videoTimeMarks.push_back(negativeFramesVector.back() + 1);
-        }
-    }
+            // treats possible changes in the current frame label
+            if (overwriteLabels && !frameLoading && getFrameLabel(frameLabels, currentVideoFrameNumber)
+                                   != currentLabel)
+                recordFrameLabels(labelJournal, currentVideoFrameNumber,
+                                  currentVideoFrameNumber + 1, currentLabel);
 
-    // last video frame
-    videoTimeMarks.push_back(totalFramesCount);
+            // the clock restarts whenever the playback starts or changes its speed
+            if (playbackClock.videoShowingDelay != videoShowingDelay)
+                restartPlaybackClock(&playbackClock, videoShowingDelay);
+            if (videoShowingDelay > 0 && !frameLoading)
+                registerFramePresentation(&playbackClock);
 
-    // ETF file writer
-    ofstream etfFileWriter(etfFilePath.data());
-    if (etfFileWriter.fail()) {
-        cerr << "Could not write file " << etfFilePath << "." << endl;
-        throw -1;
-    }
+            // prepares the current frame to be rendered
+            prepareToRenderFrameStatus(&currentFrame, currentVideoFrameNumber,
+                                       frameSource->frameCount - 1, videoShowingDelay, playReverse,
+                                       overwriteLabels, currentLabel, frameLabels,
+                                       frameLoading, &playbackClock);
+            Mat timeline = currentFrame.rowRange(
+                    timelineStrip->top, timelineStrip->top + timelineStrip->renderedStrip.rows);
+            drawTimelineStatus(&timeline, timelineStrip, frameLabels, currentVideoFrameNumber);
+            if (showStageTimes)
+                drawStageTimesPanel(&currentFrame, FRAME_HEADER_HEIGHT);
+            recordStageTime(STAGE_FRAME_COMPOSE, composeBeginTime);
+        }
 
-    for (int i = 0; i < videoTimeMarks.size() - 1; i++) {
-        double time = videoTimeMarks.at(i) / videoFPS;
-        double duration = (videoTimeMarks.at(i + 1) / videoFPS) - time;
+        // shows the current frame, until the next one is due
+        // (when replaying a key script, the composed frame is the only sink)
+        chrono::steady_clock::time_point showBeginTime = chrono::steady_clock::now();
+        if (keyScript == NULL)
+            imshow("Frame Labeler", currentFrame);
+        recordStageTime(STAGE_FRAME_SHOW, showBeginTime);
+
+        int waitTime = (frameLoading ? 1 :
+                        videoShowingDelay > 0 ? getPresentationWaitTime(&playbackClock) : 0);
+        chrono::steady_clock::time_point keyBeginTime = chrono::steady_clock::now();
+        key = (keyScript == NULL ? waitKeyOrTimelineChange(timelineStrip, waitTime)
+                                 : waitScriptedKey(keyScript, waitTime));
+        recordStageTime(STAGE_KEY_WAIT, keyBeginTime);
+
+        // there is no window to show a full size frame, when replaying a key script
+        if (keyScript != NULL && key == 'f')
+            key = -1;
+
+        // increases (or decreases, if reversed) the current frame number by the frames
+        // that are due, as long as they are ready (otherwise, the current frame is shown
+        // once more); the skipped frames are labeled as well
+        if (videoShowingDelay > 0 && !frameLoading) {
+            int dueFrameCount = getDueFrameCount(&playbackClock);
+            int step = (playReverse ? -1 : 1);
+
+            int advancedFrameCount = 0;
+            while (advancedFrameCount < dueFrameCount
+                   && currentVideoFrameNumber + step >= 0
+                   && currentVideoFrameNumber + step < frameSource->frameCount
+                   && isVideoFrameCached(prefetcher, currentVideoFrameNumber + step)) {
+                if (advancedFrameCount > 0 && overwriteLabels
+                    && getFrameLabel(frameLabels, currentVideoFrameNumber) != currentLabel)
+                    recordFrameLabels(labelJournal, currentVideoFrameNumber,
+                                      currentVideoFrameNumber + 1, currentLabel);
+
+                currentVideoFrameNumber = currentVideoFrameNumber + step;
+                advancedFrameCount++;
+            }
 
-        if (duration > 0) {
-            etfFileWriter << videoFileName << " 1 " << time << " " << duration
-                          << " event - " << event << " - "
-                          << (beginsNegative ? 'f' : 't') << endl;
+            if (dueFrameCount > 0)
+                advancePlaybackClock(&playbackClock, advancedFrameCount);
         }
 
-        beginsNegative = !beginsNegative;
-    }
+        // treats an eventual click on the timeline strip
+        if (timelineStrip->seekFrameNumber >= 0) {
+            overwriteLabels = false;
+            videoShowingDelay = 0;
+            currentVideoFrameNumber = timelineStrip->seekFrameNumber;
+            timelineStrip->seekFrameNumber = -1;
+        }
 
-    // adds the numbers of the positive frames to the ETF file as comments
-    // (a little help to non-ETF format enthusiasts)
-    if (!positiveFramesVector.empty()) {
-        etfFileWriter << "# positive frames" << endl;
-        for (int i = 0; i < positiveFramesVector.size(); i++)
-            etfFileWriter << "# " << positiveFramesVector.at(i) << endl;
+        // treats an eventual pressed key
+        treatKeyboardInput(key, &currentVideoFrameNumber, &videoShowingDelay, &playReverse,
+                           &overwriteLabels, &currentLabel, &showStageTimes, frameSource,
+                           frameLabels, labelJournal, shotBegins);
+        publishPlaybackState(prefetcher, currentVideoFrameNumber, playReverse,
+                             videoShowingDelay);
+
+        // journals where the annotator stopped
+        if (videoShowingDelay == 0)
+            recordJournalPosition(labelJournal, currentVideoFrameNumber);
     }
 
-    // closes the ETF file
-    etfFileWriter.close();
+    if (keyScript != NULL)
+        reportKeyScriptReplay(keyScript, prefetcher, frameLabels);
+
+    // frees some memory
+    stopFramePrefetcher(prefetcher);
+    delete prefetcher;
+
+    return key == 'n';
 }
 
 /** Annotates a given video as entirely negative.
@@ -1046,65 +3906,13 @@ void generateAndSaveETFFile(string etfFilePath, string event, double videoFPS,
  *  Parameter <event> is a string defining the event being annotated as negative. */
 void annotateEntireVideoAsNegative(string videoFilePath, string etfFilePath,
                                    string event) {
-    // obtains the frame rate, with the help of ffprobe
-    double frameRate = 0;
-    {
-        stringstream shellScript;
-        shellScript << "ffprobe -i " << videoFilePath
-                    << " -v quiet -show_streams -select_streams v 2>&1 | grep 'avg_frame_rate=' | cut -c16-";
-
-        FILE *pipe = popen(shellScript.str().data(), "r");
-        if (!pipe) {
-            cerr << "WARNING: Could not obtain video frame rate, with FFprobe."
-                 << endl;
-            throw -1;
-        } else {
-            char buffer[128];
-            string result = "";
-
-            while (!feof(pipe))
-                if (fgets(buffer, 128, pipe) != NULL)
-                    result += buffer;
-            pclose(pipe);
-
-            vector <string> frameRateTokens;
-            split(frameRateTokens, result, is_any_of("/"));
-
-            double numerator, denominator;
-            numerator = atof(frameRateTokens.front().data());
-            denominator = atof(frameRateTokens.back().data());
-
-            frameRate = numerator / denominator;
-        }
-    }
-
-    // obtains the total number of frames, with the help of ffprobe
-    int frameCount = 0;
-    {
-        stringstream shellScript;
-        shellScript << "ffprobe -i " << videoFilePath
-                    << " -v quiet -show_streams -select_streams v 2>&1 | grep 'nb_frames=' | cut -c11-";
-
-        FILE *pipe = popen(shellScript.str().data(), "r");
-        if (!pipe) {
-            cerr << "WARNING: Couldn't obtain video frame count, with FFprobe."
-                 << endl;
-            throw -2;
-        } else {
-            char buffer[128];
-            string result = "";
-
-            while (!feof(pipe))
-                if (fgets(buffer, 128, pipe) != NULL)
-                    result += buffer;
-            pclose(pipe);
-
-            frameCount = atoi(result.data());
-        }
+    // obtains the duration of the video, from the video catalog
+    VideoMetadata videoMetadata;
+    if (!getVideoMetadata(&VIDEO_CATALOG, videoFilePath, &videoMetadata)) {
+        cerr << "Could not probe video " << videoFilePath << "." << endl;
+        throw -1;
     }
-
-    // calculates the duration of the video
-    double duration = frameCount / frameRate;
+    double duration = videoMetadata.duration;
 
     // obtains the video file name
     string videoFileName;
@@ -1126,6 +3934,35 @@ void annotateEntireVideoAsNegative(string videoFilePath, string etfFilePath,
     etfFileWriter.close();
 }
 
+/** Worker of the frame extraction pool. Keeps on taking the next video from the shared
+ *  job queue <jobOrder> (indices of <videoFilePaths>, of which next position is given by
+ *  <nextJobPosition>) and extracting its frames, until the queue is over.
+ *
+ *  Parameter <filesCount> counts the treated video files, and it is protected, together
+ *  with the progress logging, by <progressMutex>. */
+void runVideoFrameExtractionWorker(vector <string> *videoFilePaths, vector<int> *jobOrder,
+                                   atomic<int> *nextJobPosition, int *filesCount,
+                                   mutex *progressMutex, string frameDirPath,
+                                   int totalPixelCount, int encoderThreadCount,
+                                   int segmentCount, bool packFrames, int dedupHashDistance) {
+    for (int jobPosition = (*nextJobPosition)++; jobPosition < jobOrder->size();
+         jobPosition = (*nextJobPosition)++) {
+        // file path of the current video
+        string currentVideoFilePath = videoFilePaths->at(jobOrder->at(jobPosition));
+
+        // extracts the frames from the current video
+        extractAndSaveVideoFrames(currentVideoFilePath, frameDirPath, totalPixelCount,
+                                  encoderThreadCount, segmentCount, packFrames,
+                                  dedupHashDistance);
+
+        // counts one more treated file, and logs it
+        lock_guard <mutex> progressLock(*progressMutex);
+        (*filesCount)++;
+        cout << "Progress: treated files " << *filesCount << "/"
+             << videoFilePaths->size() << " (" << currentVideoFilePath << ")." << endl;
+    }
+}
+
 /** Individually extracts the frames from the videos refereed by the given list of video
  *  file paths. It is recommended for the videos to be in H.264 MPEG-4 format. The frames
  *  are output as JPG images, named with their video file name + frame number + a sequence
@@ -1133,135 +3970,488 @@ void annotateEntireVideoAsNegative(string videoFilePath, string etfFilePath,
  *  desired total number of pixels per frame, or 0 if the original size shall be maintained.
  *  If the new desired total number of pixels is greater than the original one, the sizes of
  *  the frames are simply maintained. The number of threads to let run simultaneously when
- *  extracting the frames must also be informed. */
+ *  extracting the frames must also be informed, as well as the number of segments
+ *  <segmentCount> into which each video is split, to be decoded in parallel. If
+ *  <packFrames> is TRUE, the frames of each video are packed into a single archive file.
+ *  If <dedupHashDistance> is not negative, the near duplicate frames are not saved (see
+ *  extractAndSaveVideoFrames()).
+ *
+ *  The videos are handed to a pool of <simThreadCount> workers, longest video first
+ *  (according to their durations in the video catalog), so that a worker never waits
+ *  for the others before taking a new video, and the long videos do not end up running
+ *  alone. */
 void runVideoFrameExtraction(vector <string> *videoFilePaths,
-                             string frameDirPath, int totalPixelCount, int simThreadCount) {
+                             string frameDirPath, int totalPixelCount, int simThreadCount,
+                             int segmentCount, bool packFrames, int dedupHashDistance) {
     // time register
     cout << "Begin time: " << getCurrentDateTime() << endl;
 
     // holds the number of treated video files
     int filesCount = 0;
 
-    // for each video file path
-    for (int i = 0; i < videoFilePaths->size(); i = i + simThreadCount) {
-        // current group of up to <simThreadCount> threads
-        std::vector <std::thread> descriptionThreadGroup;
-
-        for (int j = 0; j < simThreadCount; j++) {
-            if (i + j < videoFilePaths->size()) {
-                // file path of the current video
-                string currentVideoFilePath = videoFilePaths->at(i + j);
-
-                // thread creation to extract the chosen frames from the current video
-                descriptionThreadGroup.emplace_back(
-                        extractAndSaveVideoFrames,
-                        currentVideoFilePath, frameDirPath, totalPixelCount
-                );
-
-                // counts one more treated file
-                filesCount++;
-            } else
-                break;
-        }
-
-        // executes the current thread group
-        for (auto &thread: descriptionThreadGroup)
-            if (thread.joinable())
-                thread.join();
+    // shares the available cores among the encoders of the videos extracted together
+    int encoderThreadCount = thread::hardware_concurrency() / simThreadCount;
+    if (encoderThreadCount < 1)
+        encoderThreadCount = 1;
 
-        // logging
-        cout << "Progress: treated files " << filesCount << "/"
-             << videoFilePaths->size() << "." << endl;
+    // orders the videos from the longest to the shortest one
+    vector<double> videoDurations;
+    for (int i = 0; i < videoFilePaths->size(); i++) {
+        VideoMetadata videoMetadata;
+        videoDurations.push_back(getVideoMetadata(&VIDEO_CATALOG, videoFilePaths->at(i),
+                                                  &videoMetadata) ? videoMetadata.duration : 0);
     }
 
+    vector<int> jobOrder;
+    for (int i = 0; i < videoFilePaths->size(); i++)
+        jobOrder.push_back(i);
+    stable_sort(jobOrder.begin(), jobOrder.end(), [&videoDurations](int a, int b) {
+        return videoDurations.at(a) > videoDurations.at(b);
+    });
+
+    // runs the pool of workers over the ordered videos
+    atomic<int> nextJobPosition(0);
+    mutex progressMutex;
+
+    vector <thread> extractionThreads;
+    for (int i = 0; i < simThreadCount && i < jobOrder.size(); i++)
+        extractionThreads.emplace_back(runVideoFrameExtractionWorker, videoFilePaths,
+                                       &jobOrder, &nextJobPosition, &filesCount,
+                                       &progressMutex, frameDirPath, totalPixelCount,
+                                       encoderThreadCount, segmentCount, packFrames,
+                                       dedupHashDistance);
+
+    for (auto &extractionThread: extractionThreads)
+        extractionThread.join();
+
     // time register
     cout << "End time: " << getCurrentDateTime() << endl;
 }
 
-/** Executes the interface to support the annotation of a given list of frames,
- *  related to a target video.
+/** Video of an annotation session: its frames, labels and output ETF file. The video
+ *  is loaded (frame source, labels and first frames) in background while the previous
+ *  one is annotated, and saved in background once the session moves on. */
+struct VideoAnnotation {
+    string inputFilePath;
+    string outputETFFilePath, journalFilePath;
+
+    VideoFrameSource frameSource;
+    double videoFPS;
+    FrameLabelStore frameLabels;
+    int initialFrameNumber;
+
+    // frames from the initial one on, loaded before the video is shown
+    VideoFrameCache preloadedFrames;
+
+    // first frames of the shots of the video (detected in mode 0)
+    vector<int> shotBegins;
+
+    LabelJournal labelJournal;
+    TimelineStrip timelineStrip;
+
+    // threads loading and saving the video, and the errors they eventually threw
+    thread *loadingThread, *savingThread;
+    int loadingError, savingError;
+};
+
+/** Loads the given video <videoAnnotation>: opens its frames, recovers its labels (from
+ *  the journal of an unfinished session, or else from the input ETF index
+ *  <inputETFIndex>, if not NULL) and loads the first frames to be shown.
+ *
+ *  Parameter <etfDirPath> is the directory of the output ETF file, which is named after
+ *  the video, if the output ETF file path of the video was not given.
+ *
+ *  Parameter <videoFPS> defines the frame rate of the video, or is ZERO if it must be
+ *  taken from the video catalog. */
+void loadVideoAnnotation(VideoAnnotation *videoAnnotation, ETFIndex *inputETFIndex,
+                         string etfDirPath, double videoFPS) {
+    // opens the frames of the video to be annotated
+    VideoFrameSource *frameSource = &videoAnnotation->frameSource;
+    openVideoFrameSource(videoAnnotation->inputFilePath, frameSource);
+
+    // looks up the frame rate of the video (or of the video of the frames) in the catalog
+    VideoMetadata videoMetadata;
+    if (videoFPS > 0)
+        videoAnnotation->videoFPS = videoFPS;
+    else if (getFrameSourceVideoMetadata(frameSource, &videoMetadata))
+        videoAnnotation->videoFPS = videoMetadata.frameRate;
+    else {
+        videoAnnotation->videoFPS = 25.0;
+        cerr << "WARNING: The frame rate of video " << frameSource->videoFileName
+             << " is not known from the video catalog; assuming "
+             << videoAnnotation->videoFPS << " FPS (see option -f)." << endl;
+    }
+    cout << "Video " << frameSource->videoFileName << " FPS: " << videoAnnotation->videoFPS
+         << endl;
+
+    if (videoAnnotation->outputETFFilePath.length() <= 0)
+        videoAnnotation->outputETFFilePath = etfDirPath + "/" + frameSource->videoFileName
+                                             + ".etf";
+    videoAnnotation->journalFilePath = videoAnnotation->outputETFFilePath + ".journal";
+
+    // recovers an eventual previous session that did not finish, from its journal
+    FrameLabelStore *frameLabels = &videoAnnotation->frameLabels;
+    videoAnnotation->initialFrameNumber = 0;
+    if (fileExists(videoAnnotation->journalFilePath)) {
+        cout << "Recovering unfinished session from journal: "
+             << videoAnnotation->journalFilePath << endl;
+        initFrameLabelStore(frameLabels, frameSource->frameCount, NO_LABEL);
+        replayLabelJournal(videoAnnotation->journalFilePath, frameLabels,
+                           &videoAnnotation->initialFrameNumber);
+    }
+
+        // takes the labels of the eventual input ETF file
+    else if (inputETFIndex != NULL) {
+        initFrameLabelStore(frameLabels, frameSource->frameCount, NO_LABEL);
+
+        vector <pair<int, int>> frameIntervals;
+        vector<int> intervalLabels;
+        getETFFrameIntervals(inputETFIndex, frameSource->videoFileName,
+                             videoAnnotation->videoFPS, &frameIntervals, &intervalLabels);
+        for (int i = 0; i < frameIntervals.size(); i++) {
+            int firstFrameNumber = frameIntervals.at(i).first;
+            int lastFrameNumber = frameIntervals.at(i).second;
+
+            // the labels of deduplicated frames are the ones of the frames they stand for
+            if (frameSource->deduplicated && firstFrameNumber < lastFrameNumber) {
+                firstFrameNumber = getDedupFrameNumber(&frameSource->dedupMap, firstFrameNumber);
+                lastFrameNumber = getDedupFrameNumber(&frameSource->dedupMap,
+                                                      lastFrameNumber - 1) + 1;
+            }
+
+            setFrameLabels(frameLabels, firstFrameNumber, lastFrameNumber,
+                           intervalLabels.at(i));
+        }
+    }
+
+        // else, all the frames are negative
+    else
+        initFrameLabelStore(frameLabels, frameSource->frameCount, NEGATIVE_LABEL);
+
+    // loads the shot boundaries, if they were detected
+    if (!loadShotBoundaries(getShotBoundaryFilePath(frameSource->frameDirPath,
+                                                    frameSource->videoFileName),
+                            &videoAnnotation->shotBegins))
+        cout << "No shot boundaries for video " << frameSource->videoFileName
+             << "; taking it as a single shot." << endl;
+
+    // the shots of deduplicated frames begin at the frames that stand for their begins
+    if (frameSource->deduplicated) {
+        vector<int> shotBegins;
+        for (int shotBegin : videoAnnotation->shotBegins) {
+            shotBegin = getDedupFrameNumber(&frameSource->dedupMap, shotBegin);
+            if (shotBegins.empty() || shotBegin > shotBegins.back())
+                shotBegins.push_back(shotBegin);
+        }
+        videoAnnotation->shotBegins = shotBegins;
+    }
+
+    // loads the first window of frames to be shown, on the frame decoding pool
+    // (in a single job, if read straight from a video file, which decodes forward)
+    initVideoFrameCache(&videoAnnotation->preloadedFrames, 4 * VIDEO_FRAME_BUFFERS_SIZE);
+    int firstFrameNumber = max(min(videoAnnotation->initialFrameNumber,
+                                   frameSource->frameCount - 1), 0);
+    int lastFrameNumber = min(firstFrameNumber + VIDEO_FRAME_BUFFERS_SIZE,
+                              frameSource->frameCount);
+    vector<Mat> frames(max(lastFrameNumber - firstFrameNumber, 0));
+    if (frameSource->videoReader != NULL)
+        runFrameDecodingJobs(&FRAME_DECODING_POOL, 1, [&](int) {
+            for (int i = 0; i < frames.size(); i++)
+                frames.at(i) = readVideoFrame(frameSource, firstFrameNumber + i, PREVIEW_SCALE);
+        });
+    else
+        runFrameDecodingJobs(&FRAME_DECODING_POOL, frames.size(), [&](int i) {
+            frames.at(i) = readVideoFrame(frameSource, firstFrameNumber + i, PREVIEW_SCALE);
+        });
+
+    for (int i = 0; i < frames.size(); i++)
+        putCachedVideoFrame(&videoAnnotation->preloadedFrames, firstFrameNumber + i,
+                            frames.at(i));
+}
+
+/** Starts loading the given video <videoAnnotation> in background, with the same
+ *  parameters as loadVideoAnnotation(). Whatever the loading throws is kept as its
+ *  error (-1 for exceptions other than error codes), and the frames of a video that
+ *  could not be loaded are closed right away. */
+void preloadVideoAnnotation(VideoAnnotation *videoAnnotation, ETFIndex *inputETFIndex,
+                            string etfDirPath, double videoFPS) {
+    videoAnnotation->loadingError = 0;
+    videoAnnotation->loadingThread = new thread([=] {
+        int loadingError = 0;
+        try {
+            loadVideoAnnotation(videoAnnotation, inputETFIndex, etfDirPath, videoFPS);
+        } catch (int e) {
+            loadingError = e;
+        } catch (std::exception &e) {
+            cerr << "Error while loading file " << videoAnnotation->inputFilePath << ": "
+                 << e.what() << endl;
+            loadingError = -1;
+        } catch (...) {
+            loadingError = -1;
+        }
+
+        if (loadingError != 0) {
+            closeVideoFrameSource(&videoAnnotation->frameSource);
+            videoAnnotation->loadingError = loadingError;
+        }
+    });
+}
+
+/** Waits for the given video <videoAnnotation> to be loaded in background. Returns
+ *  FALSE if the loading failed, TRUE otherwise. */
+bool waitForVideoAnnotation(VideoAnnotation *videoAnnotation) {
+    videoAnnotation->loadingThread->join();
+    delete videoAnnotation->loadingThread;
+    videoAnnotation->loadingThread = NULL;
+
+    if (videoAnnotation->loadingError != 0) {
+        cerr << "Could not load file " << videoAnnotation->inputFilePath << "." << endl;
+        return false;
+    }
+    return true;
+}
+
+/** Returns the map of the kept frames of the given video <videoAnnotation>, or NULL if
+ *  its frames were not deduplicated. */
+FrameDedupMap *getVideoAnnotationDedupMap(VideoAnnotation *videoAnnotation) {
+    return videoAnnotation->frameSource.deduplicated ?
+           &videoAnnotation->frameSource.dedupMap : NULL;
+}
+
+/** Saves the labels of the given video <videoAnnotation> in its output ETF file, and
+ *  removes its journal, which is not needed anymore.
  *
- *  The frames are determined by a file containing their file paths, one per line.
- *  The path of such input file must be in <inputFilePath>.
+ *  Parameter <event> is a string defining the annotated event. */
+void saveVideoAnnotation(VideoAnnotation *videoAnnotation, string event) {
+    cout << "Saving ETF file at path: " << videoAnnotation->outputETFFilePath << endl;
+    closeLabelJournal(&videoAnnotation->labelJournal);
+    generateAndSaveETFFile(videoAnnotation->outputETFFilePath, event, videoAnnotation->videoFPS,
+                           videoAnnotation->frameSource.videoFileName,
+                           &videoAnnotation->frameLabels,
+                           getVideoAnnotationDedupMap(videoAnnotation));
+
+    // the session is over, so its journal is not needed anymore
+    remove(videoAnnotation->journalFilePath.data());
+}
+
+/** Executes the interface to support the annotation of a given list of videos, one
+ *  after the other, within a single session. While a video is annotated, the next one
+ *  is loaded in background; once the annotator moves on ('n'), the video is saved in
+ *  background. The session ends with the last video, or once the annotator quits ('q').
  *
- *  Parameter <videoFPS> defines the frame rate of the target video being annotated.
+ *  The frames of each video are determined by a file containing their file paths, one
+ *  per line, by a packed frame archive generated in mode 0, or by the video file itself
+ *  (in which case no previous frame extraction is needed). The paths of such input
+ *  files must be in <inputFilePaths>.
+ *
+ *  Parameter <videoFPS> defines the frame rate of the target videos being annotated, or
+ *  is ZERO if the frame rate of each video must be taken from the video catalog.
  *
  *  Parameter <inputETFFilePath> is the file path of a previous annotation of the
- *  target video. Please give NULL is none was done.
+ *  target videos. Please give NULL is none was done.
  *
  *  Parameter <outputETFFilePath> is the file path of the new annotation of the target
- *  video.
+ *  video, if a single one is given. Otherwise, please give NULL and the directory path
+ *  <etfDirPath> of the new annotations, which are named after their videos. While
+ *  annotating, the label changes are journaled next to each ETF file, and the journal
+ *  is periodically compacted into it; if a session does not finish, the next one with
+ *  the same output file resumes from the journal.
+ *
+ *  Parameter <event> is a string defining the event being annotated.
  *
- *  Parameter <event> is a string defining the event being annotated. */
-void runVideoAnnotationSupport(string inputFilePath, double videoFPS,
-                               string *inputETFFilePath, string outputETFFilePath, string event) {
+ *  Parameter <keyScriptFilePath> is the file path of a key script to be replayed
+ *  headless, instead of reading the keyboard. Please give NULL if none. */
+void runVideoAnnotationSupport(vector <string> *inputFilePaths, double videoFPS,
+                               string *inputETFFilePath, string *outputETFFilePath,
+                               string etfDirPath, string event, string *keyScriptFilePath) {
     // begin time
     cout << "Begin time: " << getCurrentDateTime() << endl;
 
-    // obtains a list with the file paths to the frames of the video to be annotated
-    vector <string> frameFilePaths;
-    readFrameFilePaths(inputFilePath, &frameFilePaths);
+    // the ETF files of a session go to a directory of their own
+    if (outputETFFilePath == NULL)
+        mkdir(etfDirPath.data(), 0777);
 
-    // sets with the positive and negative frames of the video
-    set<int> positiveFrames, negativeFrames;
+    // indexes the eventual input ETF file, once for all the videos
+    ETFIndex inputETFIndex;
+    if (inputETFFilePath != NULL)
+        loadETFIndex(*inputETFFilePath, &inputETFIndex);
+
+    // reads the eventual key script to be replayed
+    KeyScript keyScript;
+    if (keyScriptFilePath != NULL)
+        readKeyScript(*keyScriptFilePath, &keyScript);
+
+    // videos of the session, already annotated ones being saved in background
+    vector<VideoAnnotation *> videoAnnotations;
+    for (int i = 0; i < inputFilePaths->size(); i++) {
+        VideoAnnotation *videoAnnotation = new VideoAnnotation();
+        videoAnnotation->inputFilePath = inputFilePaths->at(i);
+        if (outputETFFilePath != NULL)
+            videoAnnotation->outputETFFilePath = *outputETFFilePath;
+        videoAnnotation->loadingThread = NULL;
+        videoAnnotation->savingThread = NULL;
+        videoAnnotation->savingError = 0;
+        videoAnnotations.push_back(videoAnnotation);
+    }
 
-    // obtains the video file name
-    string videoFileName;
+    if (!videoAnnotations.empty())
+        preloadVideoAnnotation(videoAnnotations.front(),
+                               inputETFFilePath != NULL ? &inputETFIndex : NULL, etfDirPath,
+                               videoFPS);
+
+    // first error of the session (videos that could not be loaded are skipped)
+    int sessionError = 0;
+
+    int annotatedVideoCount = 0;
+    bool nextVideoWanted = true;
+    while (nextVideoWanted && annotatedVideoCount < videoAnnotations.size()) {
+        VideoAnnotation *videoAnnotation = videoAnnotations.at(annotatedVideoCount);
+        bool videoLoaded = waitForVideoAnnotation(videoAnnotation);
+
+        // loads the next video meanwhile
+        if (annotatedVideoCount + 1 < videoAnnotations.size())
+            preloadVideoAnnotation(videoAnnotations.at(annotatedVideoCount + 1),
+                                   inputETFFilePath != NULL ? &inputETFIndex : NULL,
+                                   etfDirPath, videoFPS);
+
+        annotatedVideoCount++;
+        if (!videoLoaded) {
+            if (sessionError == 0)
+                sessionError = videoAnnotation->loadingError;
+            continue;
+        }
 
-    vector <string> tokens;
-    split(tokens, frameFilePaths.front(), is_any_of("/"));
-    videoFileName = tokens.back();
-    tokens.clear();
+        cout << "Annotating video " << annotatedVideoCount << "/"
+             << videoAnnotations.size() << ": " << videoAnnotation->inputFilePath << endl;
+
+        // journals the label changes, and compacts them into the output ETF file
+        openLabelJournal(videoAnnotation->journalFilePath, &videoAnnotation->frameLabels,
+                         videoAnnotation->initialFrameNumber, videoAnnotation->outputETFFilePath,
+                         event, videoAnnotation->videoFPS,
+                         videoAnnotation->frameSource.videoFileName,
+                         getVideoAnnotationDedupMap(videoAnnotation),
+                         &videoAnnotation->labelJournal);
+
+        // timeline strip of the video, with thumbnails generated in background
+        // (cached next to the output ETF file, if not next to the input file)
+        startTimelineStrip(&videoAnnotation->timelineStrip, &videoAnnotation->frameSource,
+                           videoAnnotation->inputFilePath,
+                           getDirPath(videoAnnotation->outputETFFilePath));
+
+        // shows the video content, with annotation support
+        nextVideoWanted = showVideoFrames(&videoAnnotation->frameSource,
+                                          &videoAnnotation->frameLabels,
+                                          &videoAnnotation->labelJournal,
+                                          videoAnnotation->initialFrameNumber,
+                                          &videoAnnotation->timelineStrip,
+                                          keyScriptFilePath != NULL ? &keyScript : NULL,
+                                          &videoAnnotation->preloadedFrames,
+                                          &videoAnnotation->shotBegins);
+        stopTimelineStrip(&videoAnnotation->timelineStrip);
+        closeVideoFrameSource(&videoAnnotation->frameSource);
+        videoAnnotation->preloadedFrames.frames.clear();
+
+        // generates and saves the ETF file in background
+        // (-1 as the error of exceptions other than error codes)
+        videoAnnotation->savingThread = new thread([=] {
+            try {
+                saveVideoAnnotation(videoAnnotation, event);
+            } catch (int e) {
+                videoAnnotation->savingError = e;
+            } catch (std::exception &e) {
+                cerr << "Error while saving the labels of file " << videoAnnotation->inputFilePath
+                     << ": " << e.what() << endl;
+                videoAnnotation->savingError = -1;
+            } catch (...) {
+                videoAnnotation->savingError = -1;
+            }
+        });
+    }
 
-    split(tokens, videoFileName, is_any_of("-"));
-    videoFileName = tokens.front();
-    tokens.clear();
+    // waits for the videos still being loaded or saved
+    for (VideoAnnotation *videoAnnotation : videoAnnotations) {
+        if (videoAnnotation->loadingThread != NULL) {
+            videoAnnotation->loadingThread->join();
+            delete videoAnnotation->loadingThread;
+            if (videoAnnotation->loadingError == 0)
+                closeVideoFrameSource(&videoAnnotation->frameSource);
+        }
 
-    // holds the total number of frames
-    int totalFramesCount = frameFilePaths.size();
+        if (videoAnnotation->savingThread != NULL) {
+            videoAnnotation->savingThread->join();
+            delete videoAnnotation->savingThread;
+            if (videoAnnotation->savingError != 0 && sessionError == 0)
+                sessionError = videoAnnotation->savingError;
+        }
 
-    // reads the eventual input ETF file
-    if (inputETFFilePath != NULL) {
-        // obtains the name of the video file to be annotated
-        string parsedVideoFileName;
+        delete videoAnnotation;
+    }
+    stopFrameDecodingPool(&FRAME_DECODING_POOL);
 
-        vector <string> tokens;
-        split(tokens, frameFilePaths.front(), is_any_of("/"));
-        parsedVideoFileName = tokens.back();
-        tokens.clear();
+    if (sessionError != 0)
+        throw sessionError;
 
-        split(tokens, parsedVideoFileName, is_any_of("-"));
-        parsedVideoFileName = tokens.front();
-        tokens.clear();
+    // end time
+    cout << "End time: " << getCurrentDateTime() << endl;
+}
 
-        readInputETFFile(parsedVideoFileName, videoFPS, *inputETFFilePath,
-                         &positiveFrames, &negativeFrames);
-    }
+/** Worker of the negative annotation pool. Keeps on taking the next video of
+ *  <videoFilePaths> (of which position is given by <nextJobPosition>) and annotating it
+ *  as entirely negative, until the list is over.
+ *
+ *  Parameter <filesCount> counts the treated video files, and it is protected, together
+ *  with the progress logging and the first error of the videos that could not be
+ *  annotated <annotationError>, by <progressMutex>. */
+void runVideoAnnotationAsNegativeWorker(vector <string> *videoFilePaths, string event,
+                                        string etfDirPath, atomic<int> *nextJobPosition, int *filesCount,
+                                        int *annotationError, mutex *progressMutex) {
+    for (int jobPosition = (*nextJobPosition)++; jobPosition < videoFilePaths->size();
+         jobPosition = (*nextJobPosition)++) {
+        // obtains the current video file path
+        string currentVideoFilePath = videoFilePaths->at(jobPosition);
 
-        // else, all the frames are negative
-    else
-        for (int i = 0; i < frameFilePaths.size(); i++)
-            negativeFrames.insert(i);
+        // defines the name of the current ETF file
+        vector <string> currentVideoFilePathTokens;
+        split(currentVideoFilePathTokens, currentVideoFilePath, is_any_of("/"));
+        string currentVideoFileName = currentVideoFilePathTokens.back();
+        currentVideoFilePathTokens.clear();
 
-    // shows the video content, with annotation support
-    showVideoFrames(&frameFilePaths, &positiveFrames, &negativeFrames);
+        stringstream currentETFFilePathStream;
+        currentETFFilePathStream << etfDirPath << "/" << currentVideoFileName
+                                 << ".etf";
+        string currentETFFilePath = currentETFFilePathStream.str();
 
-    // generates and saves the ETF file
-    cout << "Saving ETF file at path: " << outputETFFilePath << endl;
-    generateAndSaveETFFile(outputETFFilePath, event, videoFPS, videoFileName,
-                           totalFramesCount, &positiveFrames, &negativeFrames);
+        // annotates the current video as entirely negative
+        // (a video that cannot be annotated does not stop the others)
+        int currentError = 0;
+        try {
+            annotateEntireVideoAsNegative(currentVideoFilePath, currentETFFilePath,
+                                          event);
+        } catch (int e) {
+            currentError = e;
+        }
 
-    // end time
-    cout << "End time: " << getCurrentDateTime() << endl;
+        // logging
+        lock_guard <mutex> progressLock(*progressMutex);
+        (*filesCount)++;
+        if (currentError != 0 && *annotationError == 0)
+            *annotationError = currentError;
+        cout << "Progress: treated file " << *filesCount << "/"
+             << videoFilePaths->size() << (currentError != 0 ? " (failed)." : ".") << endl;
+    }
 }
 
 /** Annotates the videos listed in <videoFilePaths> as entirely negative, with respect to
  *  a given event, by the means of its string name <event>.
  *
  *  Parameter <etfDirPath> is the directory path of the ETF files generated, one for each
- *  given video file. */
+ *  given video file. The videos are probed through the video catalog, so that reruns
+ *  skip the videos already probed.
+ *
+ *  Parameter <simThreadCount> is the number of workers annotating the videos in
+ *  parallel. */
 void runVideoAnnotationAsNegative(vector <string> *videoFilePaths, string event,
-                                  string etfDirPath) {
+                                  string etfDirPath, int simThreadCount) {
     // tries to open the given directory path to store the extracted frames
     DIR *pDir;
     pDir = opendir(etfDirPath.data());
@@ -1280,36 +4470,30 @@ void runVideoAnnotationAsNegative(vector <string> *videoFilePaths, string event,
     // time register
     cout << "Begin time: " << getCurrentDateTime() << endl;
 
-    // for each video file
-    for (int i = 0; i < videoFilePaths->size(); i++) {
-        // obtains the current video file path
-        string currentVideoFilePath = videoFilePaths->at(i);
-
-        // defines the name of the current ETF file
-        vector <string> currentVideoFilePathTokens;
-        split(currentVideoFilePathTokens, currentVideoFilePath, is_any_of("/"));
-        string currentVideoFileName = currentVideoFilePathTokens.back();
-        currentVideoFilePathTokens.clear();
+    // hands the videos to the pool of workers
+    atomic<int> nextJobPosition(0);
+    int filesCount = 0, annotationError = 0;
+    mutex progressMutex;
 
-        stringstream currentETFFilePathStream;
-        currentETFFilePathStream << etfDirPath << "/" << currentVideoFileName
-                                 << ".etf";
-        string currentETFFilePath = currentETFFilePathStream.str();
+    vector <thread> annotationThreads;
+    for (int i = 0; i < simThreadCount; i++)
+        annotationThreads.emplace_back(runVideoAnnotationAsNegativeWorker, videoFilePaths,
+                                       event, etfDirPath, &nextJobPosition,
+                                       &filesCount, &annotationError, &progressMutex);
 
-        // annotates the current video as entirely negative
-        annotateEntireVideoAsNegative(currentVideoFileName, currentETFFilePath,
-                                      event);
+    for (auto &annotationThread: annotationThreads)
+        annotationThread.join();
 
-        // logging
-        cout << "Progress: treated file " << (i + 1) << "/"
-             << videoFilePaths->size() << "." << endl;
-    }
+    if (annotationError != 0)
+        throw annotationError;
 
     // time register
     cout << "End time: " << getCurrentDateTime() << endl;
 }
 
-/** Turns this singleton into an executable file. */
+/** Turns this singleton into an executable file (unless it is included by another one,
+ *  such as the benchmark, which defines FRAME_LABELER_NO_MAIN). */
+#ifndef FRAME_LABELER_NO_MAIN
 int main(int paramCount, char **params) {
     cout << "*** FrameLabeler Execution. *** " << endl;
 
@@ -1334,6 +4518,12 @@ int main(int paramCount, char **params) {
             string frameDirPath = "";    // -f parameter
             int totalPixelCount = 0;        // -p parameter
             int simThreadCount = 1;            // -t parameter
+            int segmentCount = 1;              // -s parameter
+            int packFrames = 0;                // -a parameter
+            string stageTimesFilePath = "";    // -m parameter
+            string videoCatalogFilePath = getDefaultVideoCatalogFilePath(); // -c parameter
+            int dedupHashDistance = -1;        // -d parameter
+            int detectShots = 0;               // -b parameter
 
             try {
                 if (paramCount <= 2)
@@ -1386,6 +4576,62 @@ int main(int paramCount, char **params) {
                             }
                             break;
 
+                        case 's':
+                            segmentCount = 0; // invalid value
+                            currentParameterStream >> segmentCount;
+                            if (segmentCount < 1) {
+                                cerr
+                                        << "The -s parameter must be equal or greater than ONE."
+                                        << endl;
+                                throw -9;
+                            }
+                            break;
+
+                        case 'a':
+                            packFrames = -1; // invalid value
+                            currentParameterStream >> packFrames;
+                            if (packFrames != 0 && packFrames != 1) {
+                                cerr << "The -a parameter must be either ZERO or ONE."
+                                     << endl;
+                                throw -10;
+                            }
+                            break;
+
+                        case 'm':
+                            currentParameterStream >> stageTimesFilePath;
+                            if (stageTimesFilePath.length() <= 0) {
+                                cerr << "Please verify the -m parameter." << endl;
+                                throw -11;
+                            }
+                            break;
+
+                        case 'c':
+                            currentParameterStream >> videoCatalogFilePath;
+                            if (videoCatalogFilePath.length() <= 0) {
+                                cerr << "Please verify the -c parameter." << endl;
+                                throw -12;
+                            }
+                            break;
+
+                        case 'd':
+                            dedupHashDistance = -2; // invalid value
+                            currentParameterStream >> dedupHashDistance;
+                            if (dedupHashDistance < -1 || dedupHashDistance > 63) {
+                                cerr << "The -d parameter must be between -1 and 63." << endl;
+                                throw -13;
+                            }
+                            break;
+
+                        case 'b':
+                            detectShots = -1; // invalid value
+                            currentParameterStream >> detectShots;
+                            if (detectShots != 0 && detectShots != 1) {
+                                cerr << "The -b parameter must be either ZERO or ONE."
+                                     << endl;
+                                throw -14;
+                            }
+                            break;
+
                         default:
                             throw -8;
                     }
@@ -1399,12 +4645,20 @@ int main(int paramCount, char **params) {
                     cerr << "Please verify the -f parameter." << endl;
                     throw -5;
                 }
+                if (stageTimesFilePath.length() <= 0)
+                    stageTimesFilePath = frameDirPath + "/stage_times.json";
 
                 // logging the parameters, if they are ok
                 cout << "Parameters:" << endl << " <mode>: " << mode << endl
                      << " -i: " << videoListFilePath << endl << " -f: "
                      << frameDirPath << endl << " -p: " << totalPixelCount
-                     << endl << " -t: " << simThreadCount << endl;
+                     << endl << " -t: " << simThreadCount << endl
+                     << " -s: " << segmentCount << endl
+                     << " -a: " << packFrames << endl
+                     << " -m: " << stageTimesFilePath << endl
+                     << " -c: " << videoCatalogFilePath << endl
+                     << " -d: " << dedupHashDistance << endl
+                     << " -b: " << detectShots << endl;
             } catch (int e) {
                 cerr
                         << "Usage (with option parameters in any order): framelabeler 0"
@@ -1412,7 +4666,13 @@ int main(int paramCount, char **params) {
                         << " -f saved_frames_dir_path" << endl
                         << " -p total_pixel_count (get 0, maintain: 0, default: 0)"
                         << endl << " -t sim_thread_count (get 1, default: 1)"
-                        << endl;
+                        << endl << " -s segments_per_video (get 1, default: 1)"
+                        << endl << " -a pack_frames_into_archive (0 or 1, default: 0)"
+                        << endl << " -m stage_times_json_file_path"
+                        << " (default: saved_frames_dir_path/stage_times.json)" << endl
+                        << " -c video_catalog_file_path (default: ~/.framelabeler_catalog.txt)"
+                        << endl << " -d dedup_hash_distance (0 to 63, off: -1, default: -1)"
+                        << endl << " -b detect_shot_boundaries (0 or 1, default: 0)" << endl;
                 return 10 * e;
             }
 
@@ -1427,22 +4687,35 @@ int main(int paramCount, char **params) {
             }
 
             // frame extraction
+            SHOT_DETECTION_ENABLED = (detectShots == 1);
+            openVideoCatalog(videoCatalogFilePath, &VIDEO_CATALOG);
             try {
                 runVideoFrameExtraction(&videoFilePaths, frameDirPath,
-                                        totalPixelCount, simThreadCount);
+                                        totalPixelCount, simThreadCount, segmentCount,
+                                        packFrames == 1, dedupHashDistance);
             } catch (int e) {
                 cerr << "Could not read extract videos frames." << endl;
                 return 1000 * e;
             }
+            closeVideoCatalog(&VIDEO_CATALOG);
+
+            // stage times
+            saveStageTimes(stageTimesFilePath);
         }
 
             // mode to annotate video frames
         else if (mode == 1) {
             string inputFilePath = "";     // -i parameter
-            double videoFPS = 25.0;        // -f parameter
+            double videoFPS = 0;           // -f parameter (0: from the video catalog)
             string inputETFFilePath = "";  // -g parameter
             string event = "violence";      // -e parameter
             string outputETFFilePath = ""; // -o parameter
+            int frameBufferSize = VIDEO_FRAME_BUFFERS_SIZE; // -b parameter
+            int previewScale = PREVIEW_SCALE; // -r parameter
+            string stageTimesFilePath = "";  // -m parameter
+            string keyScriptFilePath = "";   // -k parameter
+            string sessionListFilePath = ""; // -l parameter
+            string videoCatalogFilePath = getDefaultVideoCatalogFilePath(); // -c parameter
 
             try {
                 if (paramCount <= 2)
@@ -1501,13 +4774,66 @@ int main(int paramCount, char **params) {
                             }
                             break;
 
+                        case 'b':
+                            frameBufferSize = 0; // invalid value
+                            currentParameterStream >> frameBufferSize;
+                            if (frameBufferSize < 1) {
+                                cerr
+                                        << "The -b parameter must be equal or greater than ONE."
+                                        << endl;
+                                throw -10;
+                            }
+                            break;
+
+                        case 'r':
+                            previewScale = 0; // invalid value
+                            currentParameterStream >> previewScale;
+                            if (previewScale != 1 && previewScale != 2 && previewScale != 4
+                                && previewScale != 8) {
+                                cerr << "The -r parameter must be 1, 2, 4, or 8." << endl;
+                                throw -11;
+                            }
+                            break;
+
+                        case 'm':
+                            currentParameterStream >> stageTimesFilePath;
+                            if (stageTimesFilePath.length() <= 0) {
+                                cerr << "Please verify the -m parameter." << endl;
+                                throw -12;
+                            }
+                            break;
+
+                        case 'k':
+                            currentParameterStream >> keyScriptFilePath;
+                            if (keyScriptFilePath.length() <= 0) {
+                                cerr << "Please verify the -k parameter." << endl;
+                                throw -13;
+                            }
+                            break;
+
+                        case 'l':
+                            currentParameterStream >> sessionListFilePath;
+                            if (sessionListFilePath.length() <= 0) {
+                                cerr << "Please verify the -l parameter." << endl;
+                                throw -14;
+                            }
+                            break;
+
+                        case 'c':
+                            currentParameterStream >> videoCatalogFilePath;
+                            if (videoCatalogFilePath.length() <= 0) {
+                                cerr << "Please verify the -c parameter." << endl;
+                                throw -15;
+                            }
+                            break;
+
                         default:
                             throw -9;
                     }
                 }
 
                 // treatment of mandatory parameters
-                if (inputFilePath.length() <= 0) {
+                if (inputFilePath.length() <= 0 && sessionListFilePath.length() <= 0) {
                     cerr << "Please verify the -i parameter." << endl;
                     throw -4;
                 } else if (event.length() <= 0) {
@@ -1517,36 +4843,77 @@ int main(int paramCount, char **params) {
                     cerr << "Please verify the -o parameter." << endl;
                     throw -8;
                 }
+                if (stageTimesFilePath.length() <= 0)
+                    stageTimesFilePath = outputETFFilePath + (sessionListFilePath.length() <= 0 ?
+                                                              ".stage_times.json" :
+                                                              "/stage_times.json");
 
                 // logging the parameters, if they are ok
                 cout << "Parameters:" << endl << " <mode>: " << mode << endl
                      << " -i: " << inputFilePath << endl << " -f: "
-                     << videoFPS << endl << " -g: "
+                     << (videoFPS <= 0 ? "from catalog" : to_string(videoFPS)) << endl << " -g: "
                      << (inputETFFilePath.length() <= 0 ?
                          "none" : inputETFFilePath) << endl << " -e: "
                      << event << endl << " -o: " << outputETFFilePath
-                     << endl;
+                     << endl << " -b: " << frameBufferSize << endl
+                     << " -r: " << previewScale << endl
+                     << " -m: " << stageTimesFilePath << endl
+                     << " -k: " << (keyScriptFilePath.length() <= 0 ?
+                                    "none" : keyScriptFilePath) << endl
+                     << " -l: " << (sessionListFilePath.length() <= 0 ?
+                                    "none" : sessionListFilePath) << endl
+                     << " -c: " << videoCatalogFilePath << endl;
             } catch (int e) {
                 cerr
                         << "Usage (with option parameters in any order): framelabeler 1"
-                        << endl << " -i input_file_path_with_frame_file_paths"
-                        << endl << " -f video_fps (gt 0, default: 25.0)" << endl
+                        << endl << " -i input_file_path_with_frame_file_paths (or frame archive, or video file)"
+                        << endl << " -f video_fps (gt 0, default: from the video catalog, or 25.0)"
+                        << endl
                         << " -g input_etf_file_path" << endl
                         << " -e event (string, default: violence)" << endl
-                        << " -o output_etf_file_path" << endl;
+                        << " -o output_etf_file_path" << endl
+                        << " -b frames_per_prefetch_block (get 1, default: 64)" << endl
+                        << " -r preview_scale_reduction (1, 2, 4, or 8, default: 1)" << endl
+                        << " -m stage_times_json_file_path"
+                        << " (default: output_etf_file_path.stage_times.json)" << endl
+                        << " -k key_script_file_path (replayed headless, with no window)"
+                        << endl
+                        << " -l session_list_file_path (instead of -i, one input file path per"
+                        << " line; -o is then the output ETF dir path)" << endl
+                        << " -c video_catalog_file_path (default: ~/.framelabeler_catalog.txt)"
+                        << endl;
                 return 10 * e;
             }
 
             // parameters are ok...
+            VIDEO_FRAME_BUFFERS_SIZE = frameBufferSize;
+            PREVIEW_SCALE = previewScale;
+            openVideoCatalog(videoCatalogFilePath, &VIDEO_CATALOG);
             try {
-                runVideoAnnotationSupport(inputFilePath, videoFPS,
+                // a single input file, or the input files of a session
+                vector <string> inputFilePaths;
+                if (sessionListFilePath.length() <= 0)
+                    inputFilePaths.push_back(inputFilePath);
+                else
+                    readVideoFilePathList(sessionListFilePath, &inputFilePaths);
+
+                runVideoAnnotationSupport(&inputFilePaths, videoFPS,
                                           (inputETFFilePath.length() <= 0 ?
-                                           NULL : &inputETFFilePath), outputETFFilePath,
-                                          event);
+                                           NULL : &inputETFFilePath),
+                                          (sessionListFilePath.length() <= 0 ?
+                                           &outputETFFilePath : NULL),
+                                          outputETFFilePath, event,
+                                          (keyScriptFilePath.length() <= 0 ?
+                                           NULL : &keyScriptFilePath));
             } catch (int e) {
                 cerr << "Could not annotate videos." << endl;
                 return 100 * e;
             }
+
+            closeVideoCatalog(&VIDEO_CATALOG);
+
+            // stage times
+            saveStageTimes(stageTimesFilePath);
         }
 
             // else, mode to annotate files as entirely negative
@@ -1555,6 +4922,9 @@ int main(int paramCount, char **params) {
             string videoListFilePath = "";  // -i parameter
             string etfDirPath = "";        // -o parameter
             string event = "violence";       // -e parameter
+            int simThreadCount = 1;          // -t parameter
+            string videoCatalogFilePath = getDefaultVideoCatalogFilePath(); // -c parameter
+            string stageTimesFilePath = "";  // -m parameter
 
             try {
                 if (paramCount <= 2)
@@ -1594,6 +4964,33 @@ int main(int paramCount, char **params) {
                             }
                             break;
 
+                        case 't':
+                            simThreadCount = 0; // invalid value
+                            currentParameterStream >> simThreadCount;
+                            if (simThreadCount < 1) {
+                                cerr
+                                        << "The -t parameter must be equal or greater than ONE."
+                                        << endl;
+                                throw -7;
+                            }
+                            break;
+
+                        case 'c':
+                            currentParameterStream >> videoCatalogFilePath;
+                            if (videoCatalogFilePath.length() <= 0) {
+                                cerr << "Please verify the -c parameter." << endl;
+                                throw -8;
+                            }
+                            break;
+
+                        case 'm':
+                            currentParameterStream >> stageTimesFilePath;
+                            if (stageTimesFilePath.length() <= 0) {
+                                cerr << "Please verify the -m parameter." << endl;
+                                throw -9;
+                            }
+                            break;
+
                         default:
                             throw -6;
                     }
@@ -1610,17 +5007,26 @@ int main(int paramCount, char **params) {
                     cerr << "Please verify the -e parameter." << endl;
                     throw -6;
                 }
+                if (stageTimesFilePath.length() <= 0)
+                    stageTimesFilePath = etfDirPath + "/stage_times.json";
 
                 // logging the parameters, if they are ok
                 cout << "Parameters:" << endl << " <mode>: " << mode << endl
                      << " -i: " << videoListFilePath << endl << " -o: "
-                     << etfDirPath << endl << " -e: " << event << endl;
+                     << etfDirPath << endl << " -e: " << event << endl
+                     << " -t: " << simThreadCount << endl
+                     << " -c: " << videoCatalogFilePath << endl
+                     << " -m: " << stageTimesFilePath << endl;
             } catch (int e) {
                 cerr
                         << "Usage (with option parameters in any order): framelabeler 2"
                         << endl << " -i video_list_file_path" << endl
                         << " -o output_etf_dir_path" << endl
-                        << " -e event (string, default: violence)" << endl;
+                        << " -e event (string, default: violence)" << endl
+                        << " -t sim_thread_count (get 1, default: 1)" << endl
+                        << " -c video_catalog_file_path (default: ~/.framelabeler_catalog.txt)"
+                        << endl << " -m stage_times_json_file_path"
+                        << " (default: output_etf_dir_path/stage_times.json)" << endl;
                 return 10 * e;
             }
 
@@ -1636,14 +5042,18 @@ int main(int paramCount, char **params) {
             }
 
             // annotates the file
+            openVideoCatalog(videoCatalogFilePath, &VIDEO_CATALOG);
             try {
                 runVideoAnnotationAsNegative(&videoFilePaths, event,
-                                             etfDirPath);
+                                             etfDirPath, simThreadCount);
             } catch (int e) {
                 cerr << "Could not annotate videos." << endl;
                 return 100 * e;
             }
+            closeVideoCatalog(&VIDEO_CATALOG);
 
+            // stage times
+            saveStageTimes(stageTimesFilePath);
         }
     } catch (int e) {
         cerr
@@ -1656,3 +5066,4 @@ int main(int paramCount, char **params) {
     cout << "*** Acabou! *** " << endl;
     return 0;
 }
+#endif
@@ -0,0 +1,248 @@
+/** Video Frame Labeler Benchmark
+ *
+ * Microbenchmarks of the frame labeler: frame extraction (mode 0), frame loading
+ * (mode 1), and ETF reading and writing, at several sizes. The fixtures (a synthetic
+ * video clip, its extracted frames, and ETF files with many segments) are generated
+ * locally, in the given work directory.
+ *
+ * Each benchmark is run once to warm up, then BENCHMARK_REPETITION_COUNT times; one
+ * line is output per benchmark and size, with the median and minimum times, in a
+ * stable format that can be diffed between builds.
+ *
+ * Usage: framelabeler_benchmark [work_dir_path (default: /tmp/framelabeler_benchmark)]
+ */
+
+#include <functional>
+#include <random>
+
+#define FRAME_LABELER_NO_MAIN
+#include "FrameLabeler.cpp"
+
+/** Number of timed runs of each benchmark. */
+int BENCHMARK_REPETITION_COUNT = 5;
+
+/** Number of frames of the synthetic video clips. */
+int BENCHMARK_VIDEO_FRAME_COUNT = 250;
+
+/** Frame rate of the synthetic video clips. */
+double BENCHMARK_VIDEO_FPS = 25.0;
+
+/** Stream with the benchmark results (the labeler logging itself is silenced). */
+ostream *benchmarkReport;
+
+/** Runs the given benchmark <body> once to warm up, then BENCHMARK_REPETITION_COUNT
+ *  times, and reports its median and minimum times, under the given name
+ *  <benchmarkName> and size description <sizeName>. Returns the median time. */
+double runBenchmark(string benchmarkName, string sizeName, std::function<void()> body) {
+    body();
+
+    vector<double> times;
+    for (int i = 0; i < BENCHMARK_REPETITION_COUNT; i++) {
+        chrono::steady_clock::time_point beginTime = chrono::steady_clock::now();
+        body();
+        chrono::duration<double, milli> elapsedTime = chrono::steady_clock::now() - beginTime;
+        times.push_back(elapsedTime.count());
+    }
+    sort(times.begin(), times.end());
+
+    char reportLine[256];
+    snprintf(reportLine, sizeof(reportLine), "%-28s %-16s median %10.3f ms   min %10.3f ms",
+             benchmarkName.data(), sizeName.data(), times.at(times.size() / 2), times.front());
+    *benchmarkReport << reportLine << endl;
+    return times.at(times.size() / 2);
+}
+
+/** Writes a synthetic video clip of <frameCount> frames of size <frameSize> at the given
+ *  path <videoFilePath>. The frames are deterministic (gradients, a moving box, and the
+ *  frame number), so that every run encodes the same content. */
+void generateVideoClip(string videoFilePath, Size frameSize, int frameCount) {
+    VideoWriter videoWriter(videoFilePath, VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                            BENCHMARK_VIDEO_FPS, frameSize);
+    if (!videoWriter.isOpened()) {
+        cerr << "Could not create video " << videoFilePath << "." << endl;
+        throw -1;
+    }
+
+    Mat frame(frameSize, CV_8UC3);
+    for (int i = 0; i < frameCount; i++) {
+        for (int row = 0; row < frame.rows; row++)
+            for (int col = 0; col < frame.cols; col++)
+                frame.at<Vec3b>(row, col) = Vec3b(uchar(col + i), uchar(row), uchar(row + col));
+
+        int boxSize = frameSize.height / 4;
+        int boxLeft = (i * 7) % max(frameSize.width - boxSize, 1);
+        rectangle(frame, Rect(boxLeft, frameSize.height / 2 - boxSize / 2, boxSize, boxSize),
+                  Scalar(255, 255, 255), -1);
+        putText(frame, to_string(i), Point(10, 30), FONT_HERSHEY_PLAIN, 2, Scalar(0, 0, 0));
+
+        videoWriter.write(frame);
+    }
+
+    videoWriter.release();
+}
+
+/** Writes, at <frameListFilePath>, the list of the frame files extracted from the video of
+ *  file name <videoFileName> into <frameDirPath>, as expected by mode 1. */
+void saveFrameList(string frameDirPath, string videoFileName, int frameCount,
+                   string frameListFilePath) {
+    ofstream listWriter(frameListFilePath.data());
+    for (int i = 0; i < frameCount; i++)
+        listWriter << getFrameFilePath(frameDirPath, videoFileName, i) << endl;
+    listWriter.close();
+}
+
+/** Fills the given label store <frameLabels> with <segmentCount> alternating negative and
+ *  positive runs of pseudo-random lengths (with a fixed seed). */
+void generateFrameLabels(int segmentCount, FrameLabelStore *frameLabels) {
+    mt19937 generator(42);
+    uniform_int_distribution<int> runLength(1, 50);
+
+    vector<int> runLengths;
+    int frameCount = 0;
+    for (int i = 0; i < segmentCount; i++) {
+        runLengths.push_back(runLength(generator));
+        frameCount = frameCount + runLengths.back();
+    }
+
+    initFrameLabelStore(frameLabels, frameCount, NEGATIVE_LABEL);
+    int firstFrameNumber = 0;
+    for (int i = 0; i < segmentCount; i++) {
+        if (i % 2 == 1)
+            setFrameLabels(frameLabels, firstFrameNumber, firstFrameNumber + runLengths.at(i),
+                           POSITIVE_LABEL);
+        firstFrameNumber = firstFrameNumber + runLengths.at(i);
+    }
+}
+
+/** Benchmarks the frame extraction of mode 0, from a synthetic clip of size <frameSize>,
+ *  both into frame files and into a packed archive, and into frame files with shot
+ *  detection, reporting what the detection adds to the extraction into frame files. */
+void benchmarkFrameExtraction(string workDirPath, Size frameSize) {
+    string sizeName = to_string(frameSize.width) + "x" + to_string(frameSize.height);
+    string videoFileName = "clip" + sizeName + ".avi";
+    string videoFilePath = workDirPath + "/" + videoFileName;
+    generateVideoClip(videoFilePath, frameSize, BENCHMARK_VIDEO_FRAME_COUNT);
+
+    string frameDirPath = workDirPath + "/frames" + sizeName;
+    mkdir(frameDirPath.data(), 0777);
+
+    // the same extraction, run right after with shot detection, tells what it costs
+    int encoderThreadCount = max(int(thread::hardware_concurrency()), 1);
+    double extractionTime = runBenchmark("extract_frames", sizeName, [&] {
+        extractAndSaveVideoFrames(videoFilePath, frameDirPath, 0, encoderThreadCount, 1, false, -1);
+    });
+    SHOT_DETECTION_ENABLED = true;
+    double shotExtractionTime = runBenchmark("extract_frames_shots", sizeName, [&] {
+        extractAndSaveVideoFrames(videoFilePath, frameDirPath, 0, encoderThreadCount, 1, false, -1);
+    });
+    SHOT_DETECTION_ENABLED = false;
+
+    char reportLine[256];
+    snprintf(reportLine, sizeof(reportLine), "%-28s %-16s median %+9.1f %%",
+             "shot_detection_overhead", sizeName.data(),
+             100.0 * (shotExtractionTime - extractionTime) / extractionTime);
+    *benchmarkReport << reportLine << endl;
+
+    runBenchmark("extract_frames_packed", sizeName, [&] {
+        extractAndSaveVideoFrames(videoFilePath, frameDirPath, 0, encoderThreadCount, 1, true, -1);
+    });
+}
+
+/** Waits for the given prefetcher <prefetcher> to cache the frames of numbers
+ *  [0, <frameCount>). */
+void waitForPrefetchedFrames(FramePrefetcher *prefetcher, int frameCount) {
+    unique_lock <mutex> prefetchLock(prefetcher->prefetchMutex);
+    prefetcher->loadedCondition.wait(prefetchLock, [prefetcher, frameCount] {
+        for (int frameNumber = 0; frameNumber < frameCount; frameNumber++)
+            if (!getCachedVideoFrame(&prefetcher->frameCache, frameNumber, NULL))
+                return false;
+        return true;
+    });
+}
+
+/** Benchmarks the loading of the first block of frames by the prefetcher of mode 1 (on
+ *  the frame decoding pool, from its start until the block is cached), from the
+ *  frames previously extracted from the clip of size <frameSize>, at full and reduced
+ *  preview scales, both from frame files and from the packed archive. */
+void benchmarkFrameLoading(string workDirPath, Size frameSize) {
+    string sizeName = to_string(frameSize.width) + "x" + to_string(frameSize.height);
+    string videoFileName = "clip" + sizeName + ".avi";
+    string frameDirPath = workDirPath + "/frames" + sizeName;
+
+    string frameListFilePath = frameDirPath + "/frame_list.txt";
+    saveFrameList(frameDirPath, videoFileName, BENCHMARK_VIDEO_FRAME_COUNT, frameListFilePath);
+
+    string inputFilePaths[] = {frameListFilePath,
+                               getFrameArchiveFilePath(frameDirPath, videoFileName)};
+    string sourceNames[] = {"prefetch_block_files", "prefetch_block_archive"};
+
+    for (int i = 0; i < 2; i++) {
+        VideoFrameSource frameSource;
+        openVideoFrameSource(inputFilePaths[i], &frameSource);
+        int blockSize = min(VIDEO_FRAME_BUFFERS_SIZE, frameSource.frameCount);
+
+        for (int scale : {1, 4}) {
+            PREVIEW_SCALE = scale;
+            runBenchmark(sourceNames[i] + "_1/" + to_string(scale), sizeName, [&] {
+                FramePrefetcher prefetcher;
+                startFramePrefetcher(&prefetcher, &frameSource, 0, NULL);
+                waitForPrefetchedFrames(&prefetcher, blockSize);
+                stopFramePrefetcher(&prefetcher);
+            });
+        }
+
+        PREVIEW_SCALE = 1;
+        closeVideoFrameSource(&frameSource);
+    }
+}
+
+/** Benchmarks the writing and the reading of ETF files with <segmentCount> segments. */
+void benchmarkETFFiles(string workDirPath, int segmentCount) {
+    string sizeName = to_string(segmentCount) + "_segments";
+    string etfFilePath = workDirPath + "/labels" + to_string(segmentCount) + ".etf";
+
+    FrameLabelStore frameLabels;
+    generateFrameLabels(segmentCount, &frameLabels);
+
+    runBenchmark("write_etf", sizeName, [&] {
+        generateAndSaveETFFile(etfFilePath, "violence", BENCHMARK_VIDEO_FPS, "clip.avi",
+                               &frameLabels, NULL);
+    });
+
+    runBenchmark("read_etf", sizeName, [&] {
+        FrameLabelStore readFrameLabels;
+        initFrameLabelStore(&readFrameLabels, frameLabels.frameCount, NO_LABEL);
+        readInputETFFile("clip.avi", BENCHMARK_VIDEO_FPS, etfFilePath, &readFrameLabels);
+    });
+}
+
+/** Runs all the benchmarks. */
+int main(int paramCount, char **params) {
+    string workDirPath = (paramCount > 1 ? params[1] : "/tmp/framelabeler_benchmark");
+    mkdir(workDirPath.data(), 0777);
+
+    // the labeler logs to cout, so the results go straight to its original buffer
+    ostream report(cout.rdbuf());
+    benchmarkReport = &report;
+    ofstream silencedLog("/dev/null");
+    cout.rdbuf(silencedLog.rdbuf());
+
+    try {
+        for (Size frameSize : {Size(320, 240), Size(1280, 720)}) {
+            benchmarkFrameExtraction(workDirPath, frameSize);
+            benchmarkFrameLoading(workDirPath, frameSize);
+        }
+
+        for (int segmentCount : {100, 10000, 100000})
+            benchmarkETFFiles(workDirPath, segmentCount);
+    } catch (int e) {
+        stopFrameDecodingPool(&FRAME_DECODING_POOL);
+        cout.rdbuf(report.rdbuf());
+        cerr << "Could not run the benchmarks." << endl;
+        return 10 * e;
+    }
+
+    stopFrameDecodingPool(&FRAME_DECODING_POOL);
+    cout.rdbuf(report.rdbuf());
+    return 0;
+}